@@ -12,6 +12,7 @@
 //      future work could investigate public transportation as a location that moves (use Wi-Fi).
 // *** Program Functions
 // 1)	Open a daily GPS trace file from input parameter argv[1]
+//      (or every .plt file in a directory / @list file, sorted by the date/time in the file name)
 // 2)   Create and open a daily summary GPS file from input parameter argv[1]
 // 3)	Read the first seven daily GPS trace records and throw away (header info, don't need)
 // 4)	Read input files beginning with the seventh record
@@ -30,18 +31,175 @@
 // 12)   Sort MACH2k outputfile by largest frequency and duration then by hour of the day
 // 13)  Create a summary record for each subject to summarize all the days of GPS traces into one record for
 //      calculating MACH-T value and for calculating population averages and standard deviations.
+// *** Multi-day mode
+//      When argv[1] is a directory or an @list file, all of a subject's daily trace files are processed
+//      in one run with the MACH2K totals and records kept in memory between days; the state file is read
+//      once at the start and written once at the end. Output is the same as running one file at a time.
+// *** Corpus mode
+//      -corpus [GeoLife Data directory] replaces driverv3.bat: every NNN/trajectory subject directory is
+//      processed in multi-day mode on a pool of threads, biggest subjects first, reporting the wall time and
+//      traces/sec for each subject. Build with -pthread on Linux.
+// *** State file
+//      The subject totals and location records are kept between runs in the binary ###_MACH2K.bin (a header with
+//      the run parameters, totals and a checksum, then the records as they are in memory), mapped and copied in one
+//      step on load. -export-csv ###_MACH2K.bin writes the ###_MACH2K.txt layout for the summary spreadsheet. A run
+//      with no .bin yet starts from ###_MACH2K.txt if there is one.
+// *** Multi-zoom runs
+//      argv[3] may be a list (12,14,16) or range (12-20) of zoom levels. Each trace file is read and projected
+//      once at the finest zoom level; coarser tiles are divided down from it, and each zoom level has its own
+//      ###_MACH2K_zZZ.bin/.txt, the same as a run at that zoom level alone.
+// *** Multi-threshold runs
+//      argv[4] may be a list (900,1800,3600) of secs. in place. The day's stays (runs of records in one tile)
+//      are found once per zoom level and each secs. in place only decides which of them qualify; each one has
+//      its own ###_MACH2K_sSSSS.bin/.txt (_zZZ_sSSSS with more than one zoom level).
+// *** Stream mode
+//      -stream keeps many devices' MACH2K state in memory and updates it from GPS fixes (device id and a .plt record,
+//      or a binary record) on stdin or a Unix socket, answering TRUST queries from memory between fixes. A device's
+//      fixes of one date are one trace file, so its state files are the same as a run over the same days' files.
+// *** Trace cache
+//      -make-cache converts a subject's .plt files (or every subject's, given the GeoLife Data directory) once into a
+//      compact binary NNN.m2kc: delta coded integer times and microdegree latitudes/longitudes in varint blocks, with a
+//      day index. A run given the .m2kc (and -corpus, when NNN/trajectory has one) maps it and decodes each day instead
+//      of parsing the text, with the same results as the .plt files.
+// *** Trust calibration
+//      The TRUST factors are divided by population constants (each factor's mean + 1 std dev over the subjects, first
+//      worked out by hand in mach2ktileSummaryData.xlsx). -calibrate reads every subject's state file left by -corpus,
+//      accumulates each factor's mean and variance (Welford, merged across threads) and percentiles, and writes them
+//      with the new constants to MACH2K_trust.txt. --trust-params=MACH2K_trust.txt makes any run score with them.
+//      -rescore scores every subject again from its state file header alone (the totals TRUST is taken from), in
+//      one vector pass over the subjects, with --trust-params if given, and writes them ranked to MACH2K_rescore.csv.
+// *** Engine
+//      The MACH2K update is the mach2kEngine class: one subject's state at each zoom level and secs. in place, fed a
+//      trace record (ingest()) or a trace file (ingestDay()) at a time, with trust() answered in O(1) from totals kept
+//      as each stay closes, and snapshot()/restore() in the state file layout. No globals and no exit() in it; the
+//      command line modes are thin drivers around it. To embed it, #define MACH2K_LIBRARY and #include this file in
+//      one source file of the other program (main() is left out), or build it with -c -DMACH2K_LIBRARY.
+// *** Place radius
+//      --place-radius=M makes a place a circle of M meters instead of a tile: a stay lasts while the traces are within
+//      M meters (great circle) of its first one, and a qualifying stay is counted at the nearest place within M meters
+//      of its mean position, or starts a new place there. Places are found through a uniform grid of about M meter cells, so only
+//      the neighbouring cells are searched. The place centers are kept in the state file.
+// *** Partial summaries
+//      -reduce summarizes each day on its own (the records it adds, durations kept in whole microhours, and its
+//      totals) on a pool of threads, merges the summaries pairwise and keeps the result in ###_MACH2K.part. Days
+//      can come in any order and any number of runs; the state file is rebuilt from the summary each time, the
+//      same as one multi-day run over all the days in date order. Tile places only.
+// *** Run statistics
+//      --stats=report.json (or .csv) times each stage of a subject, -reduce or -corpus run on the monotonic clock
+//      (open, parse, project, stays, apply, merge, sort, state read/write, MACH2K.txt write, each stage's own time)
+//      and counts trace records, dropped records, stays, record inserts/updates and heap allocations, with the peak
+//      RSS, per subject and in total. Off, the only cost is a thread_local pointer test at each stage.
+// *** Split days
+//      --split-days reads each trace file a record at a time to its end instead of stopping at its first change of
+//      date: every date in it is a day of its own, a day may go on into the next file, and the stay open at midnight
+//      goes on into the next day and counts in the day it ends, unless the next record is more than the trace interval
+//      later; then the day starts again as a new file does. Concatenated and multi-day exports can be read as they
+//      are; only the records of one day are kept in memory, and the pages of the file already read are dropped.
+// *** Visit logs
+//      With tile places a stay is a run of consecutive trace records in one tile, so findStays() first collapses the
+//      day's projected records into runs (tile, first and last time, records, longest gap, time toward the secs. in
+//      place and its spans) in one tight pass, and the stays are made from the runs. -make-visits writes the runs of
+//      every day at one zoom level to a NNN_zZZ.m2kv visit log, with each day's trace interval totals; a run given
+//      the .m2kv applies its days without reading, projecting or scanning a trace record, for any secs. in place.
+// *** Hour of week histograms
+//      Each location keeps the seconds of its qualifying stays in a 7 day x 24 hour histogram (split at hour
+//      boundaries), saved in the state file. The MACH2K.txt Hour and DOW columns are the location's busiest hour
+//      of the week, and the Week Regularity header column scores how concentrated in time the stays are.
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////*/
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 //#include <ctime>                  // not used currently
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <math.h>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <thread>
+#include <unordered_map>
 //#include <time.h>                 // not used currently
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+/** Vector instructions for projectTiles() and scoreTrustBatch(): AVX2 when built with -mavx2 (or -march=native), else SSE2 on x86 **/
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_WIDTH 4
+typedef __m256d simdDouble;
+#define simdGather(r,field)     _mm256_set_pd((r)[3].field, (r)[2].field, (r)[1].field, (r)[0].field)
+#define simdLoad(p)             _mm256_loadu_pd(p)
+#define simdStore(p,a)          _mm256_storeu_pd(p,a)
+#define simdSet(x)              _mm256_set1_pd(x)
+#define simdAdd(a,b)            _mm256_add_pd(a,b)
+#define simdSub(a,b)            _mm256_sub_pd(a,b)
+#define simdMul(a,b)            _mm256_mul_pd(a,b)
+#define simdDiv(a,b)            _mm256_div_pd(a,b)
+#define simdSelect(m,a,b)       _mm256_blendv_pd(b,a,m)
+#define simdGreater(a,b)        _mm256_cmp_pd(a,b,_CMP_GT_OQ)
+#define simdAnd(a,b)            _mm256_and_pd(a,b)
+#define simdExponent(x)         _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(_mm256_castpd_si256(x),52), \
+                                    _mm256_set1_epi64x(0x4330000000000000LL)))
+#define simdMantissa(x)         _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(_mm256_castpd_si256(x), \
+                                    _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm256_set1_epi64x(0x3FF0000000000000LL)))
+#define simdTruncInt(a)         _mm256_cvttpd_epi32(a)
+#define simdStoreInt(p,a)       _mm_storeu_si128((__m128i *)(p), a)
+#define simdLatitudeMask(a)     _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0),a), \
+                                    _mm256_set1_pd(85.0), _CMP_LE_OQ))
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_WIDTH 2
+typedef __m128d simdDouble;
+#define simdGather(r,field)     _mm_set_pd((r)[1].field, (r)[0].field)
+#define simdLoad(p)             _mm_loadu_pd(p)
+#define simdStore(p,a)          _mm_storeu_pd(p,a)
+#define simdSet(x)              _mm_set1_pd(x)
+#define simdAdd(a,b)            _mm_add_pd(a,b)
+#define simdSub(a,b)            _mm_sub_pd(a,b)
+#define simdMul(a,b)            _mm_mul_pd(a,b)
+#define simdDiv(a,b)            _mm_div_pd(a,b)
+#define simdSelect(m,a,b)       _mm_or_pd(_mm_and_pd(m,a), _mm_andnot_pd(m,b))
+#define simdGreater(a,b)        _mm_cmpgt_pd(a,b)
+#define simdAnd(a,b)            _mm_and_pd(a,b)
+#define simdExponent(x)         _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(_mm_castpd_si128(x),52), \
+                                    _mm_set1_epi64x(0x4330000000000000LL)))
+#define simdMantissa(x)         _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(_mm_castpd_si128(x), \
+                                    _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)), _mm_set1_epi64x(0x3FF0000000000000LL)))
+#define simdTruncInt(a)         _mm_cvttpd_epi32(a)
+#define simdStoreInt(p,a)       _mm_storel_epi64((__m128i *)(p), a)
+#define simdLatitudeMask(a)     _mm_movemask_pd(_mm_cmple_pd(_mm_andnot_pd(_mm_set1_pd(-0.0),a), _mm_set1_pd(85.0)))
+#endif
+#ifdef SIMD_WIDTH
+#define SIMD_ALL_LANES          ((1 << SIMD_WIDTH) - 1)
+#define simdEqualIntMask(a,b)   (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a,b))) & SIMD_ALL_LANES)
+#endif
 
 //https://nssdc.gsfc.nasa.gov/planetary/factsheet/earthfact.html uses 6378.137 equatorial radius, and 6356.752 polar
 #define earthRadiusKm 6371.0
@@ -49,929 +207,6377 @@
 
 using namespace std;
 
-ifstream inFile;                    //GPS trace file input
-ifstream inFileM2K;                 //first test if MACH2K.txt already exists to read records
+/** Log levels. Each log line is written with logAt(level, logOut), which writes nothing unless level is **/
+/** at or below both MAX_LOG_LEVEL (compile time) and the stream's --log-level (run time). Levels above **/
+/** MAX_LOG_LEVEL are compiled out: build with -DMAX_LOG_LEVEL=LOG_TRACE to get the per-point traces.   **/
+#define LOG_ERROR   0               // the reason for a non-zero exit code
+#define LOG_INFO    1               // a line or two per trace file, the default
+#define LOG_DEBUG   2               // location changes, MACH2K record updates and header values
+#define LOG_TRACE   3               // every trace record
+#ifndef MAX_LOG_LEVEL
+#define MAX_LOG_LEVEL LOG_INFO
+#endif
+#define logAt(level, out)   if (((level) > MAX_LOG_LEVEL) || ((level) > logLevel(out))) {} else (out)
 
-ofstream outFileM2K;                //open MACH2K.txt for writing after testing if it exists for read
-
-double machTrust = 0.0;              // Trust value between 0 and 1
-const int MAX_MACH_REC_CNT = 1000;   // Static array size is adequate for now, may make dynamic on next version
-double totDaysCnt, totHrsCnt, totLocsCnt, qualLocsCnt, totQualDura, totQualDaysCnt = 0.0; // Totals for MACH2K header record
-bool totQualDaysCntUpdate = false; // to determine if input file had at least one qualifying location/duration
-string totDaysCntStr, totHrsCntStr, totLocsCntStr, qualLocsCntStr, totQualDuraStr, totQualDaysCntStr;
-string minXtileStr, minYtileStr, maxXtileStr, maxYtileStr;
-string firstDateTime, lastDateTime;
-string fileNameDateTime, fileZoomLevel, fileDuration;
-int dow;                            // dow=Day of Week, 0-6, Sunday=0
 //string moy;                         // moy=month of year, 1-12
-// Standard time variables for converting input date string to a day of the week (same date for every record in input)
-struct tm timeDate;
-time_t t;
 
-// struct to hold the information in each input trace record
+struct traceFileStruct;
+void closeTraceFile(traceFileStruct &traceFile);
+
+// struct to hold the information in each input trace record, parsed in place from the mapped trace file
+// (the "0" and altitude fields are not kept)
 struct traceStruct
 {
-    string  latitude,   // latitude
+    double  latitude,   // latitude
     longitude,          // longitude
-    zero,               // always "0"
-    altitude,           // altitude
-    dayNum,             // number of days plus fractional part since 12/30/1899
-    YYYYMMDD,           // formatted date
-    HHMMSS;             // formatted time
+    dayNum;             // number of days plus fractional part since 12/30/1899
+    uint32_t YYYYMMDD,  // date packed as YYYYMMDD, from YYYY-MM-DD
+    HHMMSS;             // time packed as HHMMSS, from HH:MM:SS
+};
+
+// struct to hold a GPS trace file (or a binary state file) mapped into memory and the read position
+struct traceFileStruct
+{
+    const char *data = nullptr;         // first byte of the file
+    const char *next = nullptr;         // start of the next unread record
+    const char *end = nullptr;          // one past the last byte of the file
+    size_t  size = 0;
+    bool    mapped = false;             // true if data must be unmapped
+    string  buffer;                     // file contents where mmap is not available
+    int     lineNum = 0;                // line number of the last record read
+    int     badRecCnt = 0;              // malformed records skipped
+    int     firstBadLineNum = 0;        // line number of the first malformed record
+
+    ~traceFileStruct() { closeTraceFile(*this); }
 };
 struct mach2kStruct     // Discuss how changing distance factor argv[3] affects mach2k.txt reliability
 {
     // It may depend on population/building density in a given geo area
     // Probably should define a header record to save run time parameters
-    string  xTile,       // from longitude
-    yTile,               // from latitude
-    hour,                // hour of day at location
-    dow,                 // day of week at location
-//    mo,                // month at location
-    freq,                // number of times at location for minimum duration
-    dura,                // cumulative hours at location
-    traceCnt,            // cumulative trace pings at location
-    firstYYYYMMDD,       // first date at location
-    lastYYYYMMDD;        // last date at location
+    // Kept as numbers, formatted only when MACH2K.txt is written. No padding holes, the
+    // records are written to and mapped from the binary state file as they are.
+    uint32_t xTile = 0,         // from longitude
+             yTile = 0;         // from latitude
+    uint32_t freq = 0;          // number of times at location for minimum duration
+    uint8_t  hour = 0,          // hour of day at location
+             dow = 0;           // day of week at location
+//    uint8_t mo;               // month at location
+    uint16_t spare = 0;         // unused, keeps dura 8-byte aligned
+    double   dura = 0.0;        // cumulative hours at location, rounded to the 6 decimals written to MACH2K.txt
+    uint64_t traceCnt = 0;      // cumulative trace pings at location
+    uint32_t firstYYYYMMDD = 0, // first date at location, packed as YYYYMMDD
+             lastYYYYMMDD = 0;  // last date at location, packed as YYYYMMDD
     //More dense cities = smaller distance factor?
 };                                   // What is relationship of pop density to distance factor?
-mach2kStruct mach2kRec[MAX_MACH_REC_CNT];     // Up to 24 different hours of the day for 5 different locations
-
-// Prototypes
-int dayOfWeek(int d, int m, int y);
-double deg2rad(double deg);
-double distanceEarth(double latFirstLoc, double lonFirstLoc, double latSecLoc, double lonSecLoc);
-double rad2deg(double rad);
-void selectionSort(mach2kStruct mach2kRec[], int machRecCnt);
+static_assert(sizeof(mach2kStruct) == 40, "mach2kStruct is the binary state file record layout");
 
-int main(int argc, char *argv[])
+// struct to hold one MACH2K location's dwell time by day of week (Sunday=0) and hour of day, kept in
+// subjectStruct::dwellHist parallel to mach2kRec and written after the records in the state file
+struct dwellHistStruct
 {
-    int          machRecCnt = 0;
-    traceStruct  traceRec;
-    traceStruct  saveTraceRec;
-    // Will multiply by 7 (840 total) when adding days of week
-    // for now default to dow = 1, allowing for diff months, *12 = 10,080 recs
-    // May want to use linked list to avoid 10,080 recs of memory if not
-    // using all of them, although that's still a small amount of memory
-//    string mach2kHH[MAX_MACH_REC_CNT];               // Hour values for comparing with traceRec values
-//    string mach2kDOW[MAX_MACH_REC_CNT];              // dow values for comparing with traceRec values
-    int    mach2kFreq = 0;          // Number of different times subject is in qualifying location
-    int    mach2kTraceCnt = 0;      // Number of traces for a qualifying location, high value=high confidence in trust value
-    double mach2kDura = 0.0;        // Duration of time in seconds in one location
-    string junkRec;                 // read first 6 GPS trace header recs, don't write to output
-    string traceHH, saveTraceHH;    // string hour values from trace files (HH from HHMMSS)
-    istringstream issConverter;     // for converting strings to ints
-    double  saveTime, currTime, duraTime = 0.0;  // input record time in seconds for comparison/calculation
-    int    requiredTraceInterval = 600;     // Default to 10 minutes, will parameterize in future
-    double maxTraceInterval = 0.0;     // Time interval between trace records, save longest interval for header record
-    string maxTraceIntervalStr;        // String to read from MACH2K file header record
-    string maxTraceIntervalHHMMSS;     // Save the time of day when longest interval ended
-    double minTraceInterval = 3600.0;  // Smallest trace interval, set a large value (1 hour) so it will decrease
-    string minTraceIntervalStr;
-    int    qualTraceCnt = 0;           // Count traces during qualifying locations to prevent spoofing
-    int    totQualTraceCnt = 0;        // Total traces in qualified locations (for duraTime minimum)
-    string totQualTraceCntStr;
-    double totTraceInterval = 0.0;     // Total of all trace intervals
-    string totTraceIntervalStr;
-    int    traceRecCnt = 0;         // Number of trace records for a subject
-    string traceRecCntStr;
-    double saveLat = 0.0;           // saved location latitude center point
-    double saveLon = 0.0;           // saved location longitude center point
-    double currLat = 0.0;
-    double currLon = 0.0;
+    uint32_t secs[7][24] = {};      // seconds of qualifying stays in each hour of the week
+};
 
-    double numTiles = 0.0;        // number of tiles at zoom level = 2^n
-    int xTileSave, yTileSave;
-    int xTileCurr, yTileCurr;
-    int minXtile = 99999999;
-    int minYtile = 99999999;
-    int maxXtile = 0;
-    int maxYtile = 0;
-    double lat_rad;                  // Latitude in radians
+// struct to hold one run of a day's consecutive trace records in the same tile (see compactRuns()), a stay
+// with tile places. Also a visit log record. Native byte order.
+struct traceRunStruct
+{
+    int32_t  xTile, yTile;
+    double   startTime, endTime;        // dayNum of the run's first and last record
+    double   duraTime;                  // days counted toward timeInPlace, as stayStruct
+    double   maxGap;                    // longest trace interval inside the run, days
+    uint32_t pointCnt;                  // trace records in the run
+    uint32_t traceCnt;                  // trace records counted for it, as stayStruct
+    uint32_t spanCnt;                   // its spans of duraTime, following those of the runs before it
+    uint32_t YYYYMMDD;                  // date of the run's last record
+};
+static_assert(sizeof(traceRunStruct) == 56, "traceRunStruct is the visit log file layout");
+static_assert(sizeof(pair<double, double>) == 16, "a stay span is two doubles in the visit log file");
 
+// struct to hold one stay found by findStays(): a run of trace records in the same tile (or within
+// --place-radius of the first one), before any timeInPlace test
+struct stayStruct
+{
+    int     xTile = 0,
+            yTile = 0;
+    double  latitude = 0.0,             // the stay's first trace record, --place-radius is measured from it
+            longitude = 0.0;
+    double  latSum = 0.0, lonSum = 0.0; // of the stay's trace records, their mean is its place with --place-radius
+    int     fixCnt = 0;                 // (only kept with --place-radius, tile stays come from compactRuns())
+    double  duraTime = 0.0;             // days counted toward timeInPlace, trace intervals up to requiredTraceInterval
+    int     traceCnt = 0;               // trace records counted for the stay, with the one that left the tile
+    uint32_t YYYYMMDD = 0;              // date of the stay's last record
+    bool    closed = false;             // false for the stay still open at the end of the file
+    size_t  spanIdx = 0,                // the stay's spans in dayStaysStruct::spans
+            spanCnt = 0;
+};
 
-//    cout << "About to do intial parameter count check" << endl;
+// struct to hold one day's stays and trace interval totals, the same for every timeInPlace of a run
+struct dayStaysStruct
+{
+    vector<stayStruct> stays;
+    vector<pair<double, double>> spans; // dayNum start/end of each span of time in a stay's duraTime, for dwellHist
+    double  totHrs = 0.0;               // hours of all trace intervals
+    double  totTraceInterval = 0.0;
+    double  maxTraceInterval = 0.0;     // longest trace interval and the time of day it ended
+    string  maxTraceIntervalHHMMSS;
+    double  minTraceInterval = HUGE_VAL;    // shortest trace interval above zero, in seconds
+    int     traceRecCnt = 0;            // trace records counted, as subjectStruct::traceRecCnt
+    int     locChanges = 0;             // tile changes, every stay but the last
+    bool    singleRec = false;          // the file has one trace record
+    vector<traceRunStruct> runs;        // with tile places, the runs the stays were made from (see compactRuns())
+    stayStruct openStay;                // the stay being added to, until endStays() (or carryStays() with --split-days)
+};
 
-    /** Get input parameter count **/
-    if (argc < 5)
-    {
-        cout << "Usage: MACH2K [YYYYMMDDHHMMSS.plt] [3-digit userid]> [zoom level(1-21)] [secs. in place (900-3600)]"
-             << endl;   // If there are less than five arguments, stop the program
-        exit(1);
-    }
+const char     M2K_STATE_MAGIC[8] = "MACH2KB";  // first 8 bytes of a binary MACH2K state file
+const uint32_t M2K_STATE_VERSION = 3;           // bump when mach2kStateStruct, mach2kStruct, dwellHistStruct or placeCenterStruct changes
 
-    /** Command line argv[3], to compare trace locations to saved mach2k.txt locations **/
-    int     zoomLevel = atof(argv[3]);       // tileLength below is based on zoom level 16 only
-    double  tileLength = 0.469;              // Future: Calculate tileLength based on zoom level and latitude
+// struct to hold the fixed header of a binary NNN_MACH2K.bin state file: the run parameters and the
+// subject totals of the MACH2K.txt header records, followed by machRecCnt mach2kStruct records, (from
+// version 2) machRecCnt dwellHistStruct histograms and (from version 3, with a placeRadius) machRecCnt
+// placeCenterStruct place centers.
+// Native byte order; the file is only moved between machines as an exported MACH2K.txt.
+struct mach2kStateStruct
+{
+    char     magic[8];                  // M2K_STATE_MAGIC
+    uint32_t version;                   // M2K_STATE_VERSION
+    uint32_t recSize;                   // sizeof(mach2kStruct)
+    uint64_t checksum;                  // FNV-1a of this header (with checksum = 0) and the records
+    char     zoomLevelStr[16];          // argv[3] as entered, must match the run
+    char     durationStr[16];           // argv[4] as entered, must match the run
+    char     programName[128];          // argv[0] of the run that wrote the file, the MACH2K.txt version=
+    char     subject[16];
+    char     firstDateTime[16], lastDateTime[16];
+    char     maxTraceIntervalHHMMSS[16];
+    double   totDaysCnt, totHrsCnt, totLocsCnt, totQualDura, totQualDaysCnt;
+    double   maxTraceInterval, minTraceInterval, totTraceInterval;
+    int32_t  minXtile, minYtile, maxXtile, maxYtile;
+    int32_t  traceRecCnt, totQualTraceCnt;
+    uint32_t machRecCnt;
+    uint32_t placeRadius;               // --place-radius meters, 0 for a tile per place (and before version 3)
+};
 
-    numTiles = pow(2,zoomLevel);
-    /** Command line argv[4], to test for time in one place/location **/
-    /** !!! May want to restrict writing records of diff. duration requirements in same file !!! **/
-    /** May want to create header record with runtime parameters to ensure invalid combinations  **/
-    /** Seems like it's okay to add to a file using longer time requirements, but not shorter    **/
-    double  timeInPlace = atol(argv[4])/(24.0*60.0*60.0);   // argv[4] in seconds, 3600sec. = 1hr., convert to fraction of day
+// struct to hold an open addressing index from packed tile key (see tileKey()) to mach2kRec index
+struct tileIndexStruct
+{
+    vector<uint64_t> keys;              // packed tile keys, capacity is a power of 2
+    vector<int>     recIdx;             // mach2kRec index for each key, -1 = empty slot
+    int     used = 0;                   // occupied slots, grown at half full
+};
 
-    inFile.open(argv[1]);       // Open a GPS trace file
-    if (!inFile)                // Open a GPS trace file
-    {
-        cout << "Cannot open input file" << argv[1] << endl; // If there are less than two arguments, then stop the program
-        exit(2);
-    }
+// struct to hold the center of one --place-radius place, kept in the state file after the histograms
+struct placeCenterStruct
+{
+    double  latitude, longitude;
+};
+static_assert(sizeof(placeCenterStruct) == 16, "placeCenterStruct is the binary state file place layout");
 
-    cout << "input name=" << argv[1] << endl;
+// struct to hold the --place-radius places (see findPlace()): their centers and a uniform grid over them,
+// cells of the radius a side in latitude degrees, so the places near a point are in a few cells around it
+struct placeIndexStruct
+{
+    vector<placeCenterStruct> centers;              // one per place, its index is the place's
+    unordered_map<uint64_t, vector<int>> cells;     // cell key (see placeCell()) to the places in the cell
+    double  cellDeg = 0.0;                          // cell side in degrees
+};
 
-    /** Get firstDateTime from input file name in case no existing MACH2k.txt file **/
-    firstDateTime = argv[1];
-    firstDateTime = firstDateTime.substr(0,14);
-    lastDateTime = firstDateTime;                   // Current file is last date if it passes validation (or else exit(6)
-    cout << "firstDateTime=" << firstDateTime << endl;
+const char     M2K_CACHE_MAGIC[8] = "MACH2KC";  // first 8 bytes of a binary trace cache file
+const int      CACHE_BLOCK_RECS = 4096;         // trace records in a trace cache block, at most
+const int64_t  CACHE_DAY_SECS = 24*60*60 + 1;   // trace cache time units per day, room for a 23:59:60 leap second
 
-    /** Save as fileNameDateTime in case existing MACH2k.txt file has a different firstDateTime **/
-    fileNameDateTime = firstDateTime;
-    cout << "fileNameDateTime=" << fileNameDateTime << endl;
+// struct to hold the header of a binary NNN.m2kc trace cache file (see writeTraceCache()), followed by
+// dayCnt traceCacheDayStruct, blockCnt traceCacheBlockStruct and dataBytes of blocks. Native byte order.
+struct traceCacheHeaderStruct
+{
+    char     magic[8];                  // M2K_CACHE_MAGIC
+    uint32_t dayCnt, blockCnt;
+    uint64_t traceRecCnt, dataBytes;
+};
+static_assert(sizeof(traceCacheHeaderStruct) == 32, "traceCacheHeaderStruct is the trace cache file layout");
 
-    /** Try to open an existing MACH2K.txt file from input parameter argv[2]: ###_MACH2K.txt **/
-    string outName = argv[2];      // argv[2] is the acct# of person using the device
-    outName.append("_MACH2K.txt");
-    inFileM2K.open(outName);  // open MACH2K as an ifstream file for reading first, to see if it exists
+// struct to hold one trace file (day) of a trace cache: its name date/time, blocks and bad record counts
+struct traceCacheDayStruct
+{
+    char     fileNameDateTime[16];      // YYYYMMDDHHMMSS from the trace file name, NUL padded
+    uint32_t firstBlock, blockCnt;
+    uint32_t traceRecCnt;
+    uint32_t badRecCnt, firstBadLineNum;    // as traceFileStruct
+    uint32_t spare;                     // unused, keeps the record a multiple of 8 bytes
+};
+static_assert(sizeof(traceCacheDayStruct) == 40, "traceCacheDayStruct is the trace cache file layout");
 
-    /** Future enhancement here: MACH2k.txt can have "seeded" records to determine trust                             **/
-    /** first date = date of first match when frequency value is currently zero or negative? to indicate seed value  **/
-    if (inFileM2K) // skip reading if no existing MACH2K.txt file
-    {
-        getline(inFileM2K, junkRec); // Get first record with column headings
-        if (junkRec.substr(0,5) != "xTile")
-        {
-            cout << "First 5 bytes of MACH2K header rec#1=" << junkRec.substr(0,5) << endl;
-            cout << "Invalid MACH2K header record. First record must begin with 'xTile'." << endl;
-            exit(3);
-        }
-
-        /** Get 2nd record distance and duration parameters **/
-        getline(inFileM2K, junkRec, '=');
-        getline(inFileM2K, fileZoomLevel, ',');  // Need to change to zoom level of 21
-        getline(inFileM2K, junkRec, '=');
-        getline(inFileM2K, fileDuration, ',');
-        getline(inFileM2K, junkRec);          // read remaining record to set up to read next record
-
-        cout << "File distance=" << fileZoomLevel << ", Zoom level parameter=" << argv[3] << endl;
-        cout << "File duration=" << fileDuration << ", Duration parameter=" << argv[4] << endl;
-        if (fileZoomLevel != argv[3])
-        {
-            cout << "Existing MACH2K file zoom level of "
-                 << fileZoomLevel << " must equal input distance limit of " << argv[3] << "." << endl;
-            exit(4);
-        }
-        if (fileDuration != argv[4])
-        {
-            cout << "Existing MACH2K file time duration of "
-                 << fileDuration << "must equal input time duration of " << argv[4] << " seconds." << endl;
-            exit(5);
-        }
-        getline(inFileM2K, junkRec);      // Skip third record, just headings for summary data
-        getline(inFileM2K, firstDateTime, ','); // Get fourth record with totals (convert to integers for accumulating)
-        getline(inFileM2K, lastDateTime, ',');
-        getline(inFileM2K, totDaysCntStr, ',');
-        getline(inFileM2K, totHrsCntStr, ',');
-        getline(inFileM2K, totLocsCntStr, ',');
-        getline(inFileM2K, qualLocsCntStr,',');
-        getline(inFileM2K, totQualDuraStr,',');
-        getline(inFileM2K, totQualDaysCntStr, ',');
-        getline(inFileM2K, junkRec, ',');  // skip percentage field, will calculate at end
-        getline(inFileM2K, minXtileStr,',');
-        getline(inFileM2K, minYtileStr,',');
-        getline(inFileM2K, maxXtileStr,',');
-        getline(inFileM2K, maxYtileStr, ',');
-        getline(inFileM2K, junkRec,',');    // skip #1 loc%, calculate at end
-        getline(inFileM2K, junkRec,',');    // skip #2 loc%, calculate at end
-        getline(inFileM2K, junkRec,',');    // skip #3 loc%, calculate at end
-        getline(inFileM2K, junkRec,',');    // skip #4 loc%, calculate at end
-        getline(inFileM2K, junkRec,',');    // skip #5 loc%, calculate at end
-        getline(inFileM2K, junkRec,',');    // skip #6 loc%, calculate at end
-        getline(inFileM2K, junkRec, ',');   // skip subject, Filename check covers that
-        getline(inFileM2K, junkRec,',');    // skip next 9 fields: QH/Qdays to TRUST
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, junkRec,',');
-        getline(inFileM2K, traceRecCntStr,',');
-        getline(inFileM2K, maxTraceIntervalStr,',');
-        getline(inFileM2K, maxTraceIntervalHHMMSS,',');
-        getline(inFileM2K, minTraceIntervalStr,',');
-        getline(inFileM2K, totTraceIntervalStr,',');
-        getline(inFileM2K, junkRec,',');           // ignore average trace interval, will recalculate
-        getline(inFileM2K, junkRec,',');           // ignore traces per day, will recalculate
-        getline(inFileM2K, totQualTraceCntStr);
-
-        totDaysCnt = stof(totDaysCntStr);
-        totHrsCnt = stof(totHrsCntStr);
-        totLocsCnt = stof(totLocsCntStr);
-        qualLocsCnt = stof(qualLocsCntStr);     //Number of locations qualifying for minimum duration time
-        totQualDura = stof(totQualDuraStr);     //Number of hours qualifying for minimum duration time
-        totQualDaysCnt = stof(totQualDaysCntStr); //Number of days with at least one qualifying location/duration
-        minXtile = stoi(minXtileStr);
-        minYtile = stoi(minYtileStr);
-        maxXtile = stoi(maxXtileStr);
-        maxYtile = stoi(maxYtileStr);
-        traceRecCnt = stoi(traceRecCntStr);
-        maxTraceInterval = stof(maxTraceIntervalStr)/(24.0*60.0*60.0); // convert seconds to days
-        minTraceInterval = stof(minTraceIntervalStr);                   // don't convert to days, too small
-        totTraceInterval = stof(totTraceIntervalStr)/(24.0*60.0*60.0); // total elapsed time of all traces
-        totQualTraceCnt = stoi(totQualTraceCntStr);
-
-    cout << "Reading: traceRecCnt=" << traceRecCnt
-         << ",maxTraceInterval=" << maxTraceInterval*24.0*60.0*60.0
-         << "minTraceInterval=" << minTraceInterval
-         << ",totTraceInterval="<< totTraceInterval*24.0*60.0*60.0
-         << ",Traces per day=" << (traceRecCnt/totDaysCnt)
-         << ",Avg. Trace=" << (totTraceInterval*24.0*60.0*60.0)/((traceRecCnt*1.0)-totDaysCnt) << endl;
-        cout << "M2K read: minXtile=" << minXtile << ",minYtile=" << minYtile << ",maxXtile=" << maxXtile
-             << ",maxYtile=" << maxYtile << endl;
-        cout << "FileNameDateTime=" << fileNameDateTime << ",lastDateTime=" << lastDateTime << endl;
-        /** If current input file date is same or earlier than the last date in MACH2K file, exit, don't double count **/
-        if ( fileNameDateTime <= lastDateTime)
-        {
-            cout << "Trace file cannot be earlier or the same date as the latest processed file date." << endl;
-            exit(6);
-        }
+// struct to hold where one block of trace records is in a trace cache's block data
+struct traceCacheBlockStruct
+{
+    uint64_t offset;
+    uint32_t traceRecCnt, bytes;
+};
+static_assert(sizeof(traceCacheBlockStruct) == 16, "traceCacheBlockStruct is the trace cache file layout");
 
-    if (qualLocsCnt > 0)
-    {
-    while (getline(inFileM2K, mach2kRec[machRecCnt].xTile, ',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].yTile, ',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].hour, ',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].dow, ',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].freq,',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].dura,',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].traceCnt,',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].firstYYYYMMDD, ',') &&
-                getline(inFileM2K, mach2kRec[machRecCnt].lastYYYYMMDD) &&
-                (machRecCnt < MAX_MACH_REC_CNT))
-        {
-            if (machRecCnt == MAX_MACH_REC_CNT)
-            {
-                cout << "Maximum records exceeded in input MACH2K file." << endl;  //File must have been altered manually
-                exit (7);
-            }
-            else
-                machRecCnt += 1;
-        } // while not eof
-    } // if (qualLocsCnt > 0)
+// struct to hold a trace cache mapped into memory and where its indexes and blocks are
+struct traceCacheStruct
+{
+    string  name;
+    traceFileStruct file;
+    traceCacheHeaderStruct header = {};
+    const traceCacheDayStruct *days = nullptr;
+    const traceCacheBlockStruct *blocks = nullptr;
+    const char *blockData = nullptr;
+};
 
-    if (machRecCnt != qualLocsCnt)
-    {
-        cout << "Mach record count error" << endl;
-        exit (8);
-    }
-    // Close the existing MACH2K file and make a backup copy
-    inFileM2K.close();
-    string temp, temp2;
-    temp = outName + ".bak";
-    temp2 = "del " + temp;            // delete existing .bak file if it exists
-    system (temp2.c_str());
-    temp2 = "copy " + outName + " " + temp;
-    system (temp2.c_str());          // make backup copy first before creating new file
+const char     M2K_PARTIAL_MAGIC[8] = "MACH2KP";    // first 8 bytes of a MACH2K partial summary file
+const uint32_t M2K_PARTIAL_VERSION = 1;             // bump when a partial summary struct (or mach2kStruct, dwellHistStruct) changes
 
-    }   // mach2k.txt file had at least one record but no more than MAX
+// struct to hold the header of a binary NNN_MACH2K.part partial summary (see reduceSubject()), followed
+// by dayCnt partialDayStruct, qualStayCnt doubles (each qualifying stay's hours) and placeCnt
+// partialPlaceStruct. Native byte order.
+struct mach2kPartialHeaderStruct
+{
+    char     magic[8];                  // M2K_PARTIAL_MAGIC
+    uint32_t version;                   // M2K_PARTIAL_VERSION
+    uint32_t dayCnt;
+    uint64_t checksum;                  // FNV-1a of the file (with checksum = 0), see partialChecksum()
+    char     zoomLevelStr[16];          // as mach2kStateStruct
+    char     durationStr[16];
+    char     subject[16];
+    int32_t  minXtile, minYtile, maxXtile, maxYtile;
+    uint32_t qualStayCnt, placeCnt;
+};
+static_assert(sizeof(mach2kPartialHeaderStruct) == 96, "mach2kPartialHeaderStruct is the partial summary file layout");
 
-    outFileM2K.open(outName);  // create and open MACH2K file for writing (erases old file)
-    if (!outFileM2K)
-    {
-        cout << "Error creating and opening output file " << outName << endl;
-        exit(9);
-    }
+// struct to hold one day of a partial summary: what applyStays() adds to the subject totals that day,
+// applied in date order by finishPartial()
+struct partialDayStruct
+{
+    char     fileNameDateTime[16];      // YYYYMMDDHHMMSS from the trace file name, NUL padded
+    char     maxTraceIntervalHHMMSS[16];
+    double   totHrs, totTraceInterval, maxTraceInterval, minTraceInterval;
+    int32_t  traceRecCnt,
+             locCnt,                    // location changes, and the open stay if it counts
+             qualTraceCnt;
+    uint32_t qualDay;                   // 1 if a stay of the day qualified
+    uint32_t firstQualStay,             // the day's qualifying stay hours in mach2kPartialStruct::qualHours
+             qualStayCnt;
+};
+static_assert(sizeof(partialDayStruct) == 88, "partialDayStruct is the partial summary file layout");
 
+// struct to hold one location of a partial summary: its MACH2K record with the duration kept exact and the
+// keys that order it among the partial summary's records the way a sequential run would
+struct partialPlaceStruct
+{
+    mach2kStruct rec;                   // dura, hour and dow are set by finishPartial()
+    int64_t  duraMicroHours = 0;        // the record's dura in microhours, each stay rounded as roundDuraHours()
+    uint64_t orderKey = 0,              // first stay at the location: YYYYMMDDHHMMSS of its day << 16 + the stay's
+             lastKey = 0;               // place among the day's qualifying stays; the same for the last stay
+    dwellHistStruct hist;
+};
+static_assert(sizeof(partialPlaceStruct) == 736, "partialPlaceStruct is the partial summary file layout");
 
-    /** Skip past the first six daily GPS trace header records **/
-    for (int i=0; i<6; i++)
-    {
-        getline(inFile, junkRec);
-    } // for i<6
+// struct to hold a partial summary of some of a subject's days at one params entry: the days in date order,
+// the locations and the qualifying tile range. Two of them merge in any order (see mergePartial()).
+struct mach2kPartialStruct
+{
+    vector<partialDayStruct> days;
+    vector<double> qualHours;           // hours of each qualifying stay, in day order then stay order
+    vector<partialPlaceStruct> places;
+    tileIndexStruct placeIndex;         // tile key to places index
+    int     minXtile = 99999999,
+            minYtile = 99999999,
+            maxXtile = 0,
+            maxYtile = 0;
+};
 
-    /** Read the first input record **/
-    if (inFile.eof())
-    {
-        exit(10);
-        cout << "Input " << argv[1] << " has no trace records." << endl;
-    }
-    else
-    {
-        // Read first input trace file record
-        // readInputTrace(&inFile, traceRec);
-        getline(inFile, saveTraceRec.latitude, ',');
-        getline(inFile, saveTraceRec.longitude, ',');
-        getline(inFile, junkRec, ',');
-        getline(inFile, junkRec, ',');
-        getline(inFile, saveTraceRec.dayNum, ',');
-        getline(inFile, saveTraceRec.YYYYMMDD, ',');
-        getline(inFile, saveTraceRec.HHMMSS);
- //       cout << "traceRec.latitude=" << traceRec.latitude << endl;
- //       cout << "traceRec.longitude=" << traceRec.longitude << endl;
+const char     M2K_VISIT_MAGIC[8] = "MACH2KV";  // first 8 bytes of a visit log file
+const uint32_t M2K_VISIT_VERSION = 1;           // bump when a visit log struct (or traceRunStruct) changes
 
-        traceRecCnt += 1;
-        qualTraceCnt += 1;
-
-        /** Get day of week (dow) and month of year (moy) from first record; stays same for the whole file **/
-        dow=dayOfWeek(stoi((saveTraceRec.YYYYMMDD).substr(7,2)),
-                      stoi((saveTraceRec.YYYYMMDD).substr(5,2)),
-                      stoi((saveTraceRec.YYYYMMDD).substr(0,4)));
-
-        /** Save the first time stamp for comparing **/
-        issConverter.clear();
-        issConverter.str(saveTraceRec.dayNum);
-        issConverter >> saveTime;
-        duraTime = 0.0;  // initialize to begin duration accumulation
-
-        /** Save the first hour of the day value **/
-        traceHH = saveTraceRec.HHMMSS;
-        saveTraceHH = saveTraceHH.substr(0,2);
-
-        /** Save the first location for comparing **/
-        issConverter.clear();
-        issConverter.str(saveTraceRec.latitude + ' ' + saveTraceRec.longitude);
-        issConverter >> saveLat;
-        issConverter >> saveLon;
-
-        /** Calculate xTileSave,yTileSave coordinates **/
-        xTileSave = numTiles * ((saveLon + 180) / 360);
-        lat_rad = deg2rad(saveLat);
-        yTileSave = (numTiles * (1 - (log(tan(lat_rad) + 1/cos(lat_rad)) / PI)) / 2);
-
-        cout << "1) xTileSave=" << xTileSave << ", yTileSave=" << yTileSave << endl;
-
-    }
-        /** Read records from the GPS trace input file until location **/
-        /** changes to a new xTile,yTile coordinate, then look to see how much time has passed **/
-        while
-            (getline(inFile, traceRec.latitude, ',') &&
-            getline(inFile, traceRec.longitude, ',') &&
-            getline(inFile, junkRec, ',') &&
-            getline(inFile, junkRec, ',') &&
-            getline(inFile, traceRec.dayNum, ',') &&
-            getline(inFile, traceRec.YYYYMMDD, ',') &&
-            getline(inFile, traceRec.HHMMSS))
-        {
-
-            /**   Check for day changing, if so, stop processing this file, should only include one day **/
-            /**   Get day of week (dow) and month of year (moy) from first record; stays same for the whole file **/
-            if (traceRec.YYYYMMDD != saveTraceRec.YYYYMMDD)
-            {
-                cout << "New day, break!" << endl;
-                break;
+// struct to hold the header of a NNN_zZZ.m2kv visit log (see writeVisitLog()), followed by dayCnt
+// visitDayStruct, runCnt traceRunStruct and spanCnt stay spans (dayNum start, end). Native byte order.
+struct visitLogHeaderStruct
+{
+    char     magic[8];                  // M2K_VISIT_MAGIC
+    uint32_t version;                   // M2K_VISIT_VERSION
+    uint32_t dayCnt;
+    uint64_t checksum;                  // FNV-1a of the file (with checksum = 0), see partialChecksum()
+    int32_t  zoomLevel;                 // of the runs' tiles
+    int32_t  requiredTraceInterval;     // trace intervals counted toward the runs' duraTime, secs.
+    uint64_t runCnt, spanCnt, traceRecCnt;
+};
+static_assert(sizeof(visitLogHeaderStruct) == 56, "visitLogHeaderStruct is the visit log file layout");
+static_assert(offsetof(visitLogHeaderStruct, checksum) == offsetof(mach2kPartialHeaderStruct, checksum),
+              "partialChecksum() skips the checksum of both");
 
-            }
+// struct to hold one trace file (day) of a visit log: its name date/time, trace interval totals and runs
+struct visitDayStruct
+{
+    char     fileNameDateTime[16];      // YYYYMMDDHHMMSS from the trace file name, NUL padded
+    double   totHrs, totTraceInterval, maxTraceInterval, minTraceInterval;     // as dayStaysStruct
+    char     maxTraceIntervalHHMMSS[12];    // as dayStaysStruct, NUL padded
+    int32_t  traceRecCnt;               // as dayStaysStruct
+    uint32_t pointCnt;                  // trace records read
+    uint32_t badRecCnt, firstBadLineNum;    // as traceFileStruct
+    uint32_t runCnt, spanCnt;
+    uint32_t spare;                     // unused, keeps the record a multiple of 8 bytes
+    uint64_t firstRun, firstSpan;
+};
+static_assert(sizeof(visitDayStruct) == 104, "visitDayStruct is the visit log file layout");
 
-            /**     Convert string geo locations in trace file to double values for comparison **/
-            issConverter.clear();
-            issConverter.str(traceRec.latitude + ' ' + traceRec.longitude);
-            issConverter >> currLat;
-            issConverter >> currLon;
+// struct to hold a visit log read into memory (it is small) and where its days, runs and spans are
+struct visitLogStruct
+{
+    string  name;
+    string  bytes;
+    visitLogHeaderStruct header = {};
+    const visitDayStruct *days = nullptr;
+    const traceRunStruct *runs = nullptr;
+    const pair<double, double> *spans = nullptr;
+};
 
-            /** Calculate xTile,yTile coordinates **/
-            xTileCurr = numTiles * ((currLon + 180) / 360);
-            lat_rad = deg2rad(currLat);
-            yTileCurr = (numTiles * (1 - (log(tan(lat_rad) + 1/cos(lat_rad)) / PI)) / 2);
+const int TRUST_FACTOR_CNT = 6;
 
-            cout << "xTileCurr=" << xTileCurr << ", yTileCurr=" << yTileCurr << endl;
+// names of the TRUST factors, the same as their MACH2K.txt header columns
+const char *const TRUST_FACTOR_NAMES[TRUST_FACTOR_CNT] = {"QH/Qdays", "QL/Qdays", "QD/TD", "QL/TL", "QH/TH", "km^2 Density"};
 
-            issConverter.clear();
-            issConverter.str(traceRec.dayNum);
-            issConverter >> currTime;
+// struct to hold the TRUST scoring model (see machTrust()): each factor is divided by its norm, the
+// population's mean + 1 std dev, and weighted. The defaults are the mach2ktileSummaryData.xlsx values.
+struct trustModelStruct
+{
+    double  weight[TRUST_FACTOR_CNT] = {.1666, .1666, .1666, .1666, .1666, .1666};
+    double  norm[TRUST_FACTOR_CNT] = {2.49, .93, .17, .003, .102, .40};
+    double  tileArea = .219961;         // km^2 of one tile, tileLength^2
+    double  maxArea = 1000.0;           // TRUST=0 if the qualifying locations' bounding area is this many km^2 or more
+    int     minQualLocs = 3;            // TRUST=0 if there are fewer qualifying locations
+    double  fullDays = 30.0;            // TRUST is scaled down for subjects with fewer days
+};
 
-            if (
-                (((currTime - saveTime)*24.0*60.0*60.0) <= requiredTraceInterval) && // 10 minute goal interval max in same tile
-                (xTileCurr == xTileSave) &&                       // Don't accumulate time if a new location
-                (yTileCurr == yTileSave)
-               )
-                duraTime += currTime - saveTime;         // add time difference since last log record to accumulated time
+// struct to hold the run time parameters from the command line
+struct runParamStruct
+{
+    string  zoomLevelStr,               // argv[3] as entered, compared to and written in MACH2K header record
+            durationStr,                // argv[4] as entered, compared to and written in MACH2K header record
+            version;                    // argv[0], written in MACH2K header record
+    int     zoomLevel = 0;              // tileLength below is based on zoom level 16 only
+    double  numTiles = 0.0;             // number of tiles at zoom level = 2^n
+    double  tileLength = 0.469;         // Future: Calculate tileLength based on zoom level and latitude
+    double  timeInPlace = 0.0;          // argv[4] in seconds converted to fraction of day
+    int     requiredTraceInterval = 600;     // Default to 10 minutes, will parameterize in future
+    int     placeRadius = 0;            // --place-radius meters, 0 for a tile per place
+    trustModelStruct trust;             // --trust-params file, or the defaults
+    string  statsName;                  // --stats report file (.json, or .csv), empty for none
+    bool    splitDays = false;          // --split-days: days by the date of each record, stays carried over midnight
+};
 
-            /** Get trace intervals for max, min, and average **/
-            totTraceInterval += (currTime - saveTime);        // Get total intervals added together to divide by traceCnt @EOF
+// struct to hold the settings of the synthetic GeoLife-style trace generator (-gen-plt and -bench)
+struct synthParamStruct
+{
+    int     daysCnt = 30;               // daily .plt files, one per day from startYYYYMMDD
+    int     sampleSecs = 5;             // seconds between trace records
+    int     placeCnt = 8;               // places the subject stays at and travels between
+    double  spreadMeters = 5000.0;      // places are up to this far from the center
+    int     dwellMinMins = 20,          // each stay at a place lasts from dwellMinMins
+            dwellMaxMins = 240;         // to dwellMaxMins minutes
+    double  jitterMeters = 8.0;         // GPS noise around a place while staying there
+    double  speedMps = 8.0;             // travel speed between places, meters per second
+    double  centerLat = 39.9139,        // Beijing, where most GeoLife traces are
+            centerLon = 116.3917;
+    uint32_t startYYYYMMDD = 20090101;  // date of the first day
+    uint64_t seed = 1;                  // same seed and settings, same trace files
+};
 
-            cout << "totTraceInterval=" << totTraceInterval << endl;
+// struct to hold one subject's MACH2K header totals and location records between daily trace files
+struct subjectStruct
+{
+    string  subject;                    // argv[2], 3-digit userid
+    bool    m2kLoaded = false;          // true if totals came from MACH2K.txt or an earlier day in this run
+    string  firstDateTime, lastDateTime;
+    double  totDaysCnt = 0.0, totHrsCnt = 0.0, totLocsCnt = 0.0, totQualDura = 0.0, totQualDaysCnt = 0.0; // Totals for MACH2K header record
+    int     minXtile = 99999999;
+    int     minYtile = 99999999;
+    int     maxXtile = 0;
+    int     maxYtile = 0;
+    int     traceRecCnt = 0;            // Number of trace records for a subject
+    double  maxTraceInterval = 0.0;     // Time interval between trace records, save longest interval for header record
+    string  maxTraceIntervalHHMMSS;     // Save the time of day when longest interval ended
+    double  minTraceInterval = 3600.0;  // Smallest trace interval, set a large value (1 hour) so it will decrease
+    double  totTraceInterval = 0.0;     // Total of all trace intervals
+    int     totQualTraceCnt = 0;        // Total traces in qualified locations (for duraTime minimum)
+    int     machRecCnt = 0;
+    vector<mach2kStruct> mach2kRec;     // one per qualifying location (machRecCnt of them), grows as locations are found
+    vector<dwellHistStruct> dwellHist;  // hour of week histogram of each mach2kRec, same index
+    tileIndexStruct tileIndex;          // tile key to mach2kRec index, rebuilt whenever mach2kRec is reordered
+    placeIndexStruct places;            // with --place-radius, each mach2kRec's place, same index
+};
 
-            if ((currTime - saveTime) > maxTraceInterval)
-            {
-                maxTraceInterval = currTime - saveTime;    // keep track of longest interval
-                maxTraceIntervalHHMMSS = traceRec.HHMMSS;
-            cout << "After increase, maxTraceInterval=" << maxTraceInterval << endl;
-            }
+/** Stages of a run timed with --stats (see stageTimer) and the counters kept with them, and their report names **/
+const int STAGE_OPEN = 0,               // trace file and trace cache open (mapped)
+          STAGE_PARSE = 1,              // trace records parsed, or decoded from a trace cache
+          STAGE_PROJECT = 2,            // tile projection, and division to coarser zoom levels
+          STAGE_STAYS = 3,              // findStays()
+          STAGE_APPLY = 4,              // stays applied to the mach2kRec records (search, insert, update)
+          STAGE_MERGE = 5,              // -reduce partial summary merges
+          STAGE_SORT = 6,               // sortLocations()
+          STAGE_STATE_READ = 7,         // state file (or old MACH2K.txt) read
+          STAGE_STATE_WRITE = 8,        // state file written
+          STAGE_M2K_WRITE = 9,          // MACH2K.txt written
+          STAGE_CNT = 10;
+const char *const STAGE_NAMES[STAGE_CNT] = {"open", "parse", "project", "stays", "apply", "merge", "sort", "stateRead",
+                                            "stateWrite", "m2kWrite"};
+const int COUNT_TRACE_FILES = 0,        // trace files (days) read
+          COUNT_TRACE_RECS = 1,         // trace records parsed
+          COUNT_BAD_RECS = 2,           // malformed trace records dropped
+          COUNT_STAYS = 3,              // stays (dwells) found, at each zoom level
+          COUNT_QUAL_STAYS = 4,         // stays of at least the secs. in place, at each params entry
+          COUNT_RECS_INSERTED = 5,      // mach2kRec records added
+          COUNT_RECS_UPDATED = 6,       // mach2kRec records added to
+          COUNT_ALLOCS = 7,             // heap allocations (operator new) and their bytes, on the subject's thread(s)
+          COUNT_ALLOC_BYTES = 8,
+          COUNT_CNT = 9;
+const char *const COUNT_NAMES[COUNT_CNT] = {"traceFiles", "traceRecs", "badRecs", "stays", "qualStays", "recsInserted",
+                                            "recsUpdated", "allocs", "allocBytes"};
+
+// struct to hold one subject's --stats instrumentation: the time and calls of each stage (not counting
+// stages timed inside it) and the counters, summed over its threads, zoom levels and secs. in place
+struct runStatsStruct
+{
+    string  subject;
+    double  wallSecs = 0.0;
+    double  stageSecs[STAGE_CNT] = {};
+    uint64_t stageCalls[STAGE_CNT] = {};
+    uint64_t count[COUNT_CNT] = {};
+    long    peakRssKB = 0;              // the process's peak resident set size when the subject finished
+};
 
-            if (
-                (((currTime - saveTime)*24.0*60.0*60.0) < minTraceInterval) &&
-                ((currTime - saveTime)*24.0*60.0*60.0 > 0)
-                )                 // Ignore trace intervals of zero
-            {
-                minTraceInterval = (currTime - saveTime)*24.0*60.0*60.0;    // keep track of shortest interval in seconds
-                cout << "After decrease, minTraceInterval=" << minTraceInterval << endl;
-            }
+/** The calling thread's --stats instrumentation, null when it is off. Kept per thread so each corpus **/
+/** subject counts its own; the engine itself has no other global state.                             **/
+thread_local runStatsStruct *activeStats = nullptr;
+thread_local int activeStage = -1;      // stage being timed on this thread, -1 for none
+thread_local chrono::steady_clock::time_point activeStageStart;
 
-            /** increment total hours accumulator for all traces, not just qualifying locations **/
-            totHrsCnt += (currTime - saveTime) * 24;     // change from days to hours
+/** Add n to a --stats counter of the calling thread, nothing when --stats is off **/
+static inline void countStat(int counter, uint64_t n)
+{
+    if (activeStats != nullptr)
+        activeStats->count[counter] += n;
+}
 
-            cout << "totHrsCnt=" << totHrsCnt << ",first duraTime=" << duraTime << endl;
+// struct to hold one subject directory of a corpus run and its results
+struct corpusSubjectStruct
+{
+    string  subject;                    // NNN subject directory name
+    string  trajectoryDir;              // NNN/trajectory, holds the .plt files, NNN_MACH2K.bin and NNN_MACH2K.txt
+    vector<string> traceNames;          // .plt files in trajectoryDir
+    uintmax_t traceBytes = 0;           // total size of the .plt files, biggest subjects are started first
+    int     status = 0;                 // processSubject() return code
+    double  daysCnt = 0.0;              // Tot days
+    int     traceRecCnt = 0;            // Trace Cnt
+    double  wallSecs = 0.0;             // elapsed seconds for the subject
+    runStatsStruct stats;               // --stats stages and counters
+};
 
-            if (
-                ((currTime - saveTime) > 0) ||        // Don't count trace records in same tile w/same time stamp
-                (xTileCurr != xTileSave) ||           // Unknown why duplicate time stamps, possible airplane travel
-                (yTileCurr != yTileSave)
-                )
-                {
-                    traceRecCnt += 1;
-                    qualTraceCnt += 1;
-                }
+// struct to hold one corpus worker thread's queue of subjects (indexes into the corpus)
+struct workQueueStruct
+{
+    mutex   lock;
+    deque<size_t> tasks;
+};
 
-            /**  Control break if new tile coordinates  **/
-            if ((xTileCurr != xTileSave) || (yTileCurr != yTileSave))
-            {
+// struct to hold a running count, mean and sum of squared differences from the mean (Welford's
+// method), with the min and max. Two of them merge exactly, so each thread can keep its own.
+struct welfordStruct
+{
+    double  count = 0.0, mean = 0.0, m2 = 0.0;
+    double  min = HUGE_VAL, max = -HUGE_VAL;
+};
 
-            /** increment total location changes counter if changed location regardless of how much time in location **/
-            /** ISSUE: What if sampling rate is 1 second and moving very fast? Would skew towards more locations **/
-            /** OPTION: Fast moving nodes should be trusted less? Poor options for network communication too. **/
-                totLocsCnt +=1;                 // increment location count whether it is saved or not
+// struct to hold one params entry's -calibrate population statistics of the TRUST factors
+struct trustStatsStruct
+{
+    welfordStruct factor[TRUST_FACTOR_CNT];
+    vector<double> values[TRUST_FACTOR_CNT];    // the factor of each subject, for the percentiles
+    int     subjectCnt = 0,             // subjects with a TRUST (see trustFactors())
+            skippedCnt = 0,             // subjects with no state file or TRUST=0
+            failedCnt = 0;              // state files that could not be read
+};
 
-            cout << "duraTime=" << duraTime << endl;
-                /** Has this location accumulated enough time (duraTime) to be stored in MACH2k.txt file? **/
-                if (duraTime >= timeInPlace)
-                {
-        cout << "duraTime > timeInPlace" << endl;
-        cout << "xTileSave=" << xTileSave << ", yTileSave=" << yTileSave << ", hour=" << saveTraceHH << ", dow=" << dow << endl;
-                qualTraceCnt +=1;
-        cout << "qualTraceCnt=" << qualTraceCnt << endl;
-                totQualDaysCntUpdate = true; // so we can increment the totQualDaysCnt value for header record
-            /** Save smallest and largest x,y tiles for qualifying tiles for output file header for range of locations **/
-                if (xTileSave < minXtile)
-                    minXtile = xTileSave;
-                if (yTileSave < minYtile)
-                    minYtile = yTileSave;
-                if (xTileSave > maxXtile)
-                    maxXtile = xTileSave;
-                if (yTileSave > maxYtile)
-                    maxYtile = yTileSave;
-
-            /** increment duration if changed location qualifies for time in location **/
-                totQualDura += duraTime * 24.0;
-
-                /** Search mach2kRec for same tile coordinates      **/
-                /** at same hour, dow and month or write new record **/
-                bool foundMachRec = false;              // Initialize flag for any match in MACH2K array
-                int bestMachRecIdx = -1;                // Initialize best location match in MACH2K array
-
-                for (int i=0; i<machRecCnt; i++)
-                {
-                    issConverter.clear();
-                    issConverter.str(mach2kRec[i].dura);    // duration in hours
-                    issConverter >> mach2kDura;
-
-                    /** Begin comparing MACH2K record locations to current input file location for FIRST match **/
-                    if ((to_string(xTileSave) == mach2kRec[i].xTile) &&
-                        (to_string(yTileSave) == mach2kRec[i].yTile))
-/**                         &&
-                        (saveTraceHH == mach2kRec[i].hour) &&
-                        (to_string(dow) == mach2kRec[i].dow)) **/
-//                        (moy == mach2kRec[i].mo))
-                    {
-            cout << "machRecCnt=" << machRecCnt << ",i=" << i << ",mach2kRec[i].xTile=" << mach2kRec[i].xTile << ",mach2kRec[i].yTile="
-                 << mach2kRec[i].yTile << endl;
-                        bestMachRecIdx = i;
-                        i=machRecCnt;           // stop at the first find, by design is the only find
-                    }
-                } // end for loop looking for existing MACH2K record
-                cout << "bestMachRecIdx=" << bestMachRecIdx << endl;
-
-                /** Update existing MACH2K record with same xTile,yTile coordinates **/
-                if (bestMachRecIdx != -1)
-                {
-                    issConverter.clear();
-                    issConverter.str(mach2kRec[bestMachRecIdx].freq);
-                    issConverter >> mach2kFreq;
-                    mach2kFreq += 1;
-
-                    mach2kDura += duraTime * 24.0; // add duration time in hrs to existing value
-
-                    if (mach2kFreq < 10)
-                        mach2kRec[bestMachRecIdx].freq = "00" + to_string(mach2kFreq);
-                    else
-                        if (mach2kFreq < 100)
-                            mach2kRec[bestMachRecIdx].freq = "0" + to_string(mach2kFreq);
-                        else
-                            if (mach2kFreq < 1000)
-                                mach2kRec[bestMachRecIdx].freq = to_string(mach2kFreq);
-
-                    if (mach2kDura < 10.0)
-                        mach2kRec[bestMachRecIdx].dura = "00" + to_string(mach2kDura);
-                    else
-                        if (mach2kDura < 100.0)
-                            mach2kRec[bestMachRecIdx].dura = '0' + to_string(mach2kDura);
-                        else
-                            if (mach2kDura < 1000.0)
-                                mach2kRec[bestMachRecIdx].dura = to_string(mach2kDura);
-
-                    cout << "mach2kRec.dura=" << mach2kRec[bestMachRecIdx].dura << endl;
-//                    mach2kRec[bestMachRecIdx].hour = saveTraceHH;
-                    mach2kRec[bestMachRecIdx].hour = "99";
-
-                    cout << "Before update, mach2kRec[bestMachRecIdx].traceCnt=" << mach2kRec[bestMachRecIdx].traceCnt << endl;
-
-                    issConverter.clear();
-                    issConverter.str(mach2kRec[bestMachRecIdx].traceCnt);
-                    issConverter >> mach2kTraceCnt;
-                    cout << "Before update, mach2kTraceCnt=" << mach2kTraceCnt << endl;
-                    mach2kTraceCnt += qualTraceCnt;
-                    totQualTraceCnt += qualTraceCnt;
-
-                    cout << "Updating MACH2K rec, mach2kTraceCnt=" << mach2kTraceCnt << ",qualTraceCnt=" << qualTraceCnt << endl;
-                    mach2kRec[bestMachRecIdx].traceCnt = to_string(mach2kTraceCnt); //No need for leading 0's, not sorting
-
-                    cout << "After update, mach2kRec[bestMachRecIdx].traceCnt=" << mach2kRec[bestMachRecIdx].traceCnt << endl;
-
-                    qualTraceCnt = 0;
-
-                    mach2kRec[bestMachRecIdx].lastYYYYMMDD = saveTraceRec.YYYYMMDD;
-                    foundMachRec = true;
-                    duraTime = 0.0;
-                } // updated existing MACH2K record
-
-                /** Create new MACH2K record if still room in memory array of records **/
-                if (!foundMachRec)
-                {
-                    if (machRecCnt < MAX_MACH_REC_CNT - 1)
-                    {
-                        mach2kRec[machRecCnt].xTile = to_string(xTileSave);
-                        mach2kRec[machRecCnt].yTile = to_string(yTileSave);
-
-        cout << "NEW REC: machRecCnt=" << machRecCnt << ",mach2kRec[machRecCnt].xTile=" << mach2kRec[machRecCnt].xTile
-             << ", mach2kRec[machRecCnt].yTile=" << mach2kRec[machRecCnt].yTile << endl;
-
-//                        mach2kRec[machRecCnt].hour = saveTraceHH;
-                        mach2kRec[machRecCnt].hour = "99";
-//                        mach2kRec[machRecCnt].dow = to_string(dow);
-                        mach2kRec[machRecCnt].dow = '9';
-                        mach2kRec[machRecCnt].freq = "001";
-                        if ((duraTime*24) < 10.0)
-                            mach2kRec[machRecCnt].dura = "00" + to_string(duraTime*24);
-                        else
-                            if ((duraTime*24) < 100.0)
-                                mach2kRec[machRecCnt].dura = '0' + to_string(duraTime*24);
-                            else
-                                if ((duraTime*24) < 1000.0)
-                                    mach2kRec[machRecCnt].dura = to_string(duraTime*24);
-                    cout << "duraTime*24=" << duraTime*24 << ", mach2kRec.dura=" << mach2kRec[machRecCnt].dura << endl;
-                    //getchar();
-
-                    cout << "New MACH2K rec, qualTraceCnt=" << qualTraceCnt << ",to_string=" << to_string(qualTraceCnt) << endl;
-
-                        mach2kRec[machRecCnt].traceCnt = to_string(qualTraceCnt);
-                        totQualTraceCnt += qualTraceCnt;
-
-                    cout << "After to_string, mach2kRec[machRecCnt].traceCnt=" << mach2kRec[machRecCnt].traceCnt << endl;
-
-                        qualTraceCnt = 0;
-
-                        mach2kRec[machRecCnt].firstYYYYMMDD = saveTraceRec.YYYYMMDD;
-                        mach2kRec[machRecCnt].lastYYYYMMDD = saveTraceRec.YYYYMMDD;
-                    cout << "mach2kRec[machRecCnt].firstYYYYMMDD=" << mach2kRec[machRecCnt].firstYYYYMMDD << endl;
-                    cout << "mach2kRec[machRecCnt].lastYYYYMMDD=" << mach2kRec[machRecCnt].lastYYYYMMDD << endl;
-                        machRecCnt += 1;
-                    cout << "updated machRecCnt=" << machRecCnt << endl;
-                        duraTime = 0.0;
-                    }
-                    else
-                    {
-                    cout << "Error: More than maximum, " << MAX_MACH_REC_CNT << ' '<< argv[2] << "MACH2K.txt records." << endl;
-                    exit(11);
-                    }
-                } // end if no record for this location yet in MACH2K file
-
-                } // end if at least minimum time in same location after reading first record in changed location
-            else
-                duraTime = 0.0;     // reset duration if change in location or below threshhold timeInPlace
-                qualTraceCnt = 0;    // also reset qualTraceCnt
+// struct to hold the MACH2K header totals the TRUST value is taken from (see machTrust())
+struct mach2kTotalsStruct
+{
+    double  totDaysCnt = 0.0, totHrsCnt = 0.0, totLocsCnt = 0.0, totQualDura = 0.0, totQualDaysCnt = 0.0;
+    int     minXtile = 99999999,
+            minYtile = 99999999,
+            maxXtile = 0,
+            maxYtile = 0;
+    int     machRecCnt = 0;
+};
 
-            cout << "got to end of new location or trace interval 60 or more seconds" << endl;
-            } // end of new location
+// struct to hold a -rescore batch: every subject's TRUST inputs (see mach2kTotalsStruct) as one array
+// per field, so the scoring model runs down the subjects a vector register at a time
+struct trustBatchStruct
+{
+    vector<string> subject;
+    vector<double> totDaysCnt, totHrsCnt, totLocsCnt, totQualDura, totQualDaysCnt;
+    vector<double> machRecCnt;          // qualifying locations
+    vector<double> xSpan, ySpan;        // qualifying tile range, max - min + 1
+    vector<double> trust;               // set by scoreTrustBatch()
+};
 
-        /** Save new trace record to compare to next trace records and to MACH2k.txt recs **/
-        saveTraceRec.latitude = traceRec.latitude;
-        saveTraceRec.longitude = traceRec.longitude;
-        saveTraceRec.dayNum = traceRec.dayNum;
-        saveTraceRec.YYYYMMDD = traceRec.YYYYMMDD;
-        saveTraceRec.HHMMSS = traceRec.HHMMSS;
+// struct to hold one params entry's totals with the open day's closed stays applied, kept up to date by
+// mach2kEngine as each stay closes, so trust() during a day needs no pass over the stays or records
+struct dayPreviewStruct
+{
+    mach2kTotalsStruct totals;
+    bool    qualDay = false;            // a stay of the day qualified
+    tileIndexStruct newTiles;           // qualifying tiles of the day that have no mach2kRec yet
+    placeIndexStruct newPlaces;         // the same with --place-radius
+};
 
-        traceHH = traceRec.HHMMSS;
-        saveTraceHH = traceHH.substr(0,2);
+// class to hold one subject's (device's) MACH2K totals and records at each params entry (zoom level and
+// secs. in place) and update them a trace record or a trace file at a time. No globals and no exit():
+// errors are returned as the program exit codes and log lines go to the logOut given. main() runs one
+// for its subject; another program can link the engine in instead (see MACH2K_LIBRARY).
+class mach2kEngine
+{
+public:
+    mach2kEngine(const vector<runParamStruct> &runParams, const string &subjectName, ostream &logOut);
+
+    bool    takesDay(const string &fileNameDateTime) const;
+    int     ingest(const traceStruct &traceRec);
+    int     ingestDay(const traceStruct traceRecs[], size_t traceCnt, const string &fileNameDateTime);
+    int     ingestStays(const dayStaysStruct &day, const string &fileNameDateTime);
+    void    endDay(const traceStruct *nextRec = nullptr);
+    double  trust(size_t paramIdx = 0) const;
+    void    snapshot(size_t paramIdx, string &stateBytes) const;
+    int     restore(size_t paramIdx, const char *stateBytes, size_t stateSize);
+
+    size_t  paramCnt() const { return params.size(); }
+    const runParamStruct &param(size_t paramIdx) const { return params[paramIdx]; }
+    subjectStruct &subject(size_t paramIdx) { return subjs[paramIdx]; }
+    bool    dayOpen() const { return openDay; }
+    uint64_t daysEnded() const { return endedDayCnt; }
+
+private:
+    int     beginDay(const string &fileNameDateTime);
+    bool    carriesStay(size_t group, const traceStruct &nextRec) const;
+    bool    newPlace(size_t paramIdx, const stayStruct &stay) const;
+    void    previewStay(size_t group, const stayStruct &stay);
+
+    vector<runParamStruct> params;
+    size_t  finest = 0;                 // params entry with the finest zoom level, trace records are projected at it
+    vector<size_t> groupParam;          // first params entry of each zoom level (trace interval, place radius), they share stays
+    vector<size_t> paramGroup;          // groupParam index of each params entry
+    vector<subjectStruct> subjs;        // one per params entry, the days ended so far
+    vector<bool> applyDay;              // params entries that take the open day
+    vector<dayStaysStruct> days;        // one per groupParam entry, the open day's stays
+    vector<dayPreviewStruct> previews;  // one per params entry, totals with the open day's closed stays
+    traceStruct lastRec;                // last trace record of the open day
+    string  dayDateTime;                // YYYYMMDDHHMMSS of the open day, its trace file name date/time
+    bool    openDay = false;
+    bool    splitDays = false;          // --split-days: a change of date may carry the open stay on (see carriesStay())
+    uint64_t endedDayCnt = 0;
+    vector<int> xTiles, yTiles;         // ingestDay() tiles at the finest zoom level, kept to reuse the memory
+    vector<int> xZoomTiles, yZoomTiles; // the same at a coarser zoom level
+    ostream *logOut;
+};
 
-        /** Save the time stamp from current read for comparing **/
-        saveTime = currTime;
+const size_t SPLIT_DROP_BYTES = 16 << 20;  // --split-days drops the pages of a trace file already read every this many bytes
 
-        /** Save the location for comparing **/
-        saveLat = currLat;
-        saveLon = currLon;
+const char STREAM_FIX_MARK = '\x02';    // first byte of a binary -stream fix, text lines never start with it
 
-        /** Save xTileSave,yTileSave coordinates **/
-        xTileSave = xTileCurr;
-        yTileSave = yTileCurr;
+// struct to hold one binary -stream fix, after a STREAM_FIX_MARK byte. Native byte order.
+struct streamFixStruct
+{
+    char     device[16];                // device (subject) id, NUL padded
+    double   latitude,                  // the .plt record fields
+             longitude,
+             dayNum;
+    uint32_t YYYYMMDD,                  // date and time of day, packed as in traceStruct
+             HHMMSS;
+};
+static_assert(sizeof(streamFixStruct) == 48, "streamFixStruct is the binary -stream fix layout");
 
-        cout << "After location break: xTileSave=" << xTileSave << ", yTileSave=" << yTileSave << endl;
+// struct to hold one device of a -stream run
+struct streamDeviceStruct
+{
+    streamDeviceStruct(const vector<runParamStruct> &params, const string &device, ostream &logOut)
+        : engine(params, device, logOut) {}
 
-    } // while traceFile still has records
+    mach2kEngine engine;                // the device's MACH2K state and open day
+    uint64_t checkpointDays = 0;        // engine.daysEnded() at the last checkpoint
+    int     status = 0;                 // readMach2kState() exit code, the device's fixes are rejected unless 0
+};
 
-    cout << "before testing for more data after EOF, saveTime=" << saveTime << ",currTime=" << currTime << endl;
+// struct to hold a -stream run: the run parameters, the devices by id and the counts reported by STATS
+struct streamStruct
+{
+    vector<runParamStruct> params;
+    string  stateDir;                   // the devices' ###_MACH2K state files are read from and written to here
+    unordered_map<string, streamDeviceStruct> devices;
+    uint64_t fixCnt = 0, rejectCnt = 0, dayCnt = 0, checkpointCnt = 0;
+};
 
-    if (
-        (((currTime - saveTime)*24.0*60.0*60.0) <= requiredTraceInterval) && // 10 minute goal interval max in same tile
-        (xTileCurr == xTileSave) &&                       // Don't accumulate time if a new location
-        (yTileCurr == yTileSave)
-        )
-        duraTime += currTime - saveTime;         // add time difference since last log record to accumulated time
+// struct to hold one -stream input, stdin or a Unix socket client, and its bytes not handled yet
+struct streamConnStruct
+{
+    int     inFd,                       // read from
+            outFd;                      // command replies written to
+    string  buffer;
+};
 
-    /** Write last record if eligible to be written and if any data since last break in location! **/
-    /** Handle situation where all records within one tile, for the whole file (happens at low zoom levels) **/
-    if ((saveTime != currTime) || (duraTime >= timeInPlace))  // duraTime will be zero if last record is new location
+// streambuf that collects log text in memory and hands it to a background thread, which
+// writes it to dest a block at a time. A flush (endl) hands over the text so far without
+// waiting for it to be written, so logging never waits on the console or the disk but a line
+// such as an error is out soon after it is logged; everything still buffered is written when
+// the asyncLogBuf is destroyed.
+class asyncLogBuf : public streambuf
+{
+public:
+    explicit asyncLogBuf(streambuf *dest) : dest(dest), writerThread(&asyncLogBuf::writer, this) {}
+    ~asyncLogBuf()
     {
-        /** increment total locations counter if new location regardless of how much time in location **/
-        totLocsCnt +=1;                 // increment location count whether it qualifies or not
-
-        totQualDaysCntUpdate = true; // so we can increment the totQualDaysCnt value for header record
-
-        cout << "EOF: duraTime=" << duraTime << endl;
-        cout << "EOF: machRecCnt=" << machRecCnt << endl;
-
-        if (duraTime >= timeInPlace)
         {
-        cout << "EOF: duraTime > timeInPlace" << endl;
-        cout << "xTileSave=" << xTileSave << ", yTileSave=" << yTileSave << ", hour=" << saveTraceHH << ", dow=" << dow << endl;
-            qualTraceCnt +=1;
-        cout << "qualTraceCnt=" << qualTraceCnt << endl;
-
-        /** Save smallest and largest x,y tiles for qualifying tiles for output file header for range of locations **/
-            if (xTileSave < minXtile)
-                minXtile = xTileSave;
-            if (yTileSave < minYtile)
-                minYtile = yTileSave;
-            if (xTileSave > maxXtile)
-                maxXtile = xTileSave;
-            if (yTileSave > maxYtile)
-                maxYtile = yTileSave;
-
-        /** increment qualifying location counter and accumulate duration if changed location qualifies for time in location **/
-            totQualDura += duraTime * 24.0;
-
-        /** Search mach2kRec for best/closest same location within distanceLimit, **/
-        /** at same hour, dow and month or write new record                       **/
-            bool foundMachRec = false;              // Initialize flag for any match in MACH2K array
-            int bestMachRecIdx = -1;                // Initialize best location match in MACH2K array
-
-            for (int i=0; i<machRecCnt; i++)
-            {
-                issConverter.clear();
-                issConverter.str(mach2kRec[i].dura);    // duration in hours
-                issConverter >> mach2kDura;
-
-                /** Begin comparing MACH2K record locations to current input file location for FIRST match **/
-                if ((to_string(xTileSave) == mach2kRec[i].xTile) &&
-                    (to_string(yTileSave) == mach2kRec[i].yTile))
-/**                         &&
-                        (saveTraceHH == mach2kRec[i].hour) &&
-                        (to_string(dow) == mach2kRec[i].dow)) **/
-//                        (moy == mach2kRec[i].mo))
-                    {
-            cout << "EOF: machRecCnt=" << machRecCnt << ",i=" << i << ",mach2kRec[i].xTile=" << mach2kRec[i].xTile << ",mach2kRec[i].yTile="
-                 << mach2kRec[i].yTile << endl;
-                        bestMachRecIdx = i;
-                        i=machRecCnt; // stop at the first find
-
-                    }
-        } // end for loop looking for existing MACH2k record
-            cout << "bestMachRecIdx=" << bestMachRecIdx << endl;
-
-            /** Update existing MACH2K record with closest location matching hour/dow **/
-            if (bestMachRecIdx != -1)
-            {
-                issConverter.clear();
-                issConverter.str(mach2kRec[bestMachRecIdx].freq);
-                issConverter >> mach2kFreq;
-                mach2kFreq += 1;
+            lock_guard<mutex> guard(lock);
+            if (!fill.empty())
+                full.push_back(move(fill));
+            done = true;
+        }
+        ready.notify_one();
+        writerThread.join();
+    }
 
-                mach2kDura += duraTime * 24.0; // add duration time in hrs to existing value
+protected:
+    int_type overflow(int_type ch) override
+    {
+        if (ch != traits_type::eof())
+        {
+            char c = (char)ch;
+            xsputn(&c, 1);
+        }
+        return traits_type::not_eof(ch);
+    }
+    streamsize xsputn(const char *text, streamsize n) override
+    {
+        fill.append(text, n);
+        if (fill.size() >= BLOCK_SIZE)
+            handOff();
+        return n;
+    }
+    int sync() override
+    {
+        if (!fill.empty())
+            handOff();
+        return 0;
+    }
 
-                if (mach2kFreq < 10)
-                    mach2kRec[bestMachRecIdx].freq = "00" + to_string(mach2kFreq);
-                else
-                    if (mach2kFreq < 100)
-                        mach2kRec[bestMachRecIdx].freq = '0' + to_string(mach2kFreq);
-                    else
-                        if (mach2kFreq < 1000)
-                            mach2kRec[bestMachRecIdx].freq = to_string(mach2kFreq);
+private:
+    static const size_t BLOCK_SIZE = 64*1024;
+    static const int    WRITE_PAUSE_MS = 20;    // text handed over after a write waits this long for more
 
-                    if (mach2kDura < 10.0)
-                        mach2kRec[bestMachRecIdx].dura = "00" + to_string(mach2kDura);
-                    else
-                        if (mach2kDura < 100.0)
-                            mach2kRec[bestMachRecIdx].dura = '0' + to_string(mach2kDura);
-                        else
-                            if (mach2kDura < 1000.0)
-                                mach2kRec[bestMachRecIdx].dura = to_string(mach2kDura);
+    /** A flushed line joins the last block waiting; the writer is woken only if it is idle **/
+    void handOff()
+    {
+        bool wake;
+        {
+            lock_guard<mutex> guard(lock);
+            if (!full.empty() && (full.back().size() + fill.size() <= BLOCK_SIZE))
+                full.back().append(fill);
+            else
+                full.push_back(move(fill));
+            wake = writerIdle;
+            writerIdle = false;
+        }
+        fill.clear();
+        if (wake)
+            ready.notify_one();
+    }
 
-                   cout << "mach2kDura=" << mach2kDura << ",mach2kRec.dura=" << mach2kRec[bestMachRecIdx].dura << endl;
+    void writer()
+    {
+        unique_lock<mutex> guard(lock);
+        while (true)
+        {
+            writerIdle = full.empty();
+            ready.wait(guard, [this] { return done || !full.empty(); });
+            writerIdle = false;
+            deque<string> blocks;
+            blocks.swap(full);
+            guard.unlock();
+            for (const string &block : blocks)
+                dest->sputn(block.data(), block.size());
+            dest->pubsync();
+            guard.lock();
+            if (done && full.empty())
+                break;
+            /** Lines flushed one at a time are written together, a write each pause at most **/
+            ready.wait_for(guard, chrono::milliseconds(WRITE_PAUSE_MS), [this] { return done; });
+        }
+    }
 
-//                mach2kRec[bestMachRecIdx].hour = saveTraceHH;
-                mach2kRec[bestMachRecIdx].hour = "99";
+    streambuf   *dest;                  // console or log file the text ends up in
+    string      fill;                   // block being filled by the logging thread
+    deque<string> full;                 // blocks waiting for the writer thread
+    mutex       lock;
+    condition_variable ready;
+    bool        done = false;
+    bool        writerIdle = false;     // the writer waits for text, a hand-off wakes it
+    thread      writerThread;           // declared last, it starts after the members above
+};
 
-                cout << "Before update, mach2kRec[bestMachRecIdx].traceCnt=" << mach2kRec[bestMachRecIdx].traceCnt << endl;
+// times one stage of a --stats run (see STAGE_OPEN ...), from construction to destruction, on the
+// monotonic clock. A stage timed inside another one pauses it, so each stage's time is its own.
+// With --stats off it costs one thread_local test.
+class stageTimer
+{
+public:
+    explicit stageTimer(int stage) : stats(activeStats)
+    {
+        if (stats == nullptr)
+            return;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (activeStage >= 0)
+            stats->stageSecs[activeStage] += chrono::duration<double>(now - activeStageStart).count();
+        outerStage = activeStage;
+        activeStage = stage;
+        activeStageStart = now;
+        stats->stageCalls[stage] += 1;
+    }
+    ~stageTimer()
+    {
+        if (stats == nullptr)
+            return;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        stats->stageSecs[activeStage] += chrono::duration<double>(now - activeStageStart).count();
+        activeStage = outerStage;
+        activeStageStart = now;
+    }
+    stageTimer(const stageTimer &) = delete;
+    stageTimer &operator=(const stageTimer &) = delete;
 
-                issConverter.clear();
-                issConverter.str(mach2kRec[bestMachRecIdx].traceCnt);
-                issConverter >> mach2kTraceCnt;
+private:
+    runStatsStruct *stats;              // activeStats when the stage started
+    int     outerStage = -1;            // stage paused by this one
+};
 
-                cout << "EOF: Before update, mach2kTraceCnt=" << mach2kTraceCnt << endl;
-                mach2kTraceCnt += qualTraceCnt;
-                totQualTraceCnt += qualTraceCnt;
+// Prototypes
+void addDwellHist(dwellHistStruct &hist, mach2kStruct &machRec, const pair<double, double> staySpans[], size_t spanCnt);
+void addQualTotals(mach2kTotalsStruct &totals, const stayStruct &stay);
+void addRunStats(runStatsStruct &total, const runStatsStruct &part);
+void addTrustBatch(trustBatchStruct &batch, const string &subject, const mach2kTotalsStruct &totals);
+void addStayRec(const traceStruct &prevRec, const traceStruct &traceRec, int xTile, int yTile,
+                int requiredTraceInterval, double placeRadius, dayStaysStruct &day, ostream &logOut);
+void addStreamFix(streamStruct &stream, const string &device, const traceStruct &fix, ostream &logOut);
+void applyStays(const dayStaysStruct &day, const string &fileNameDateTime, const runParamStruct &param,
+                subjectStruct &subj, ostream &logOut);
+void beginStays(const traceStruct &firstRec, int xTile, int yTile, dayStaysStruct &day);
+void buildMach2kPartial(const runParamStruct &param, const string &subject, const mach2kPartialStruct &partial,
+                        string &partialBytes);
+void buildMach2kState(const runParamStruct &param, const subjectStruct &subj, string &stateBytes);
+int calibrateTrust(const string &corpusDir, const vector<runParamStruct> &params, unsigned threadCnt);
+void carryStays(dayStaysStruct &day);
+int checkpointStream(streamStruct &stream, bool closeDays, ostream &logOut);
+void compactRuns(const traceStruct traceRecs[], const int xTiles[], const int yTiles[], size_t traceCnt,
+                 int requiredTraceInterval, dayStaysStruct &day);
+int dayOfWeek(int d, int m, int y);
+void dayPartial(const dayStaysStruct &day, const string &fileNameDateTime, const runParamStruct &param,
+                mach2kPartialStruct &partial);
+double deg2rad(double deg);
+double distanceEarth(double latFirstLoc, double lonFirstLoc, double latSecLoc, double lonSecLoc);
+void endStays(const traceStruct &lastRec, dayStaysStruct &day);
+int exportMach2kFile(const string &stateName, const string &m2kName, const trustModelStruct &trust);
+int findPlace(const placeIndexStruct &places, double placeRadius, double latitude, double longitude);
+void findStays(const traceStruct traceRecs[], const int xTiles[], const int yTiles[], size_t traceCnt,
+               int requiredTraceInterval, double placeRadius, dayStaysStruct &day, ostream &logOut);
+int findTileRec(const tileIndexStruct &tileIndex, uint64_t key);
+void finishPartial(const mach2kPartialStruct &partial, subjectStruct &subj);
+void handleStreamInput(streamStruct &stream, streamConnStruct &conn, ostream &logOut);
+string formatTraceDate(uint32_t YYYYMMDD);
+string formatTraceTime(uint32_t HHMMSS);
+void insertPlace(placeIndexStruct &places, double placeRadius, double latitude, double longitude);
+void insertTileRec(tileIndexStruct &tileIndex, uint64_t key, int recIdx);
+vector<corpusSubjectStruct> listCorpusSubjects(const string &corpusDir);
+vector<string> listTraceFiles(const string &dirName);
+int logLevel(ios_base &out);
+double machTrust(const runParamStruct &param, const mach2kTotalsStruct &totals);
+bool mapFile(const string &fileName, traceFileStruct &mappedFile);
+int mapTraceDay(const string &traceName, const vector<runParamStruct> &params, vector<mach2kPartialStruct> &dayParts,
+                ostream &logOut);
+bool mergePartial(mach2kPartialStruct &partial, const mach2kPartialStruct &other);
+int64_t microHours(double hours);
+bool nextCorpusTask(vector<workQueueStruct> &workQueue, unsigned self, size_t &task);
+int openTraceCache(const string &cacheName, traceCacheStruct &cache, ostream &logOut);
+bool openTraceFile(const string &traceName, traceFileStruct &traceFile);
+int openVisitLog(const string &visitName, visitLogStruct &visits, ostream &logOut);
+bool parseDurations(const string &durationArg, vector<int> &durations);
+bool parseLogLevel(const string &levelName, int &level);
+bool parseMach2kRec(const string recField[], mach2kStruct &machRec);
+int parseMach2kState(const char *stateData, size_t stateSize, const string &stateName, runParamStruct &param,
+                     subjectStruct &subj, ostream &logOut);
+bool parseTraceRec(const char *field, const char *last, traceStruct &traceRec);
+string paramFileSuffix(const vector<runParamStruct> &params, size_t paramIdx);
+bool parseZoomLevels(const string &zoomArg, vector<int> &zoomLevels);
+uint64_t partialChecksum(const string &partialBytes);
+bool partialHasDay(const mach2kPartialStruct &partial, const string &fileNameDateTime);
+long peakRssKB();
+int processCacheDay(const traceCacheStruct &cache, uint32_t dayIdx, mach2kEngine &engine, vector<traceStruct> &traceRecs,
+                    ostream &logOut);
+int processCorpus(const string &corpusDir, const vector<runParamStruct> &params, unsigned threadCnt);
+int processSubject(vector<string> traceNames, bool multiDay, const vector<string> &stateNames,
+                   mach2kEngine &engine, ostream &logOut);
+int processTraceFile(const string &traceName, mach2kEngine &engine, ostream &logOut);
+void processTraceRecs(const traceStruct traceRecs[], const int xTiles[], const int yTiles[], size_t traceCnt,
+                      const string &fileNameDateTime, const runParamStruct &param, subjectStruct &subj, ostream &logOut);
+int processTraceStream(const string &traceName, mach2kEngine &engine, ostream &logOut);
+int processVisitDay(const visitLogStruct &visits, uint32_t dayIdx, mach2kEngine &engine, dayStaysStruct &day, ostream &logOut);
+double rad2deg(double rad);
+bool readCacheDay(const traceCacheStruct &cache, const traceCacheDayStruct &day, vector<traceStruct> &traceRecs);
+int readMach2kFile(const string &m2kName, const runParamStruct &param, subjectStruct &subj, ostream &logOut);
+int readMach2kPartial(const string &partialName, const runParamStruct &param, mach2kPartialStruct &partial, ostream &logOut);
+int readMach2kState(const string &stateName, runParamStruct &param, subjectStruct &subj, ostream &logOut);
+int readStateTotals(const string &stateName, const runParamStruct &param, mach2kTotalsStruct &totals, ostream &logOut);
+int readTraceDay(traceFileStruct &traceFile, const string &traceName, vector<traceStruct> &traceRecs, ostream &logOut);
+bool readTraceRec(traceFileStruct &traceFile, traceStruct &traceRec);
+int readTrustModel(const string &modelName, trustModelStruct &trust);
+bool readVisitDay(const visitLogStruct &visits, const visitDayStruct &visitDay, dayStaysStruct &day);
+void projectTile(double lat, double lon, double numTiles, int &xTile, int &yTile);
+void projectTiles(const traceStruct traceRecs[], size_t count, double numTiles, int xTiles[], int yTiles[]);
+void rebuildPlaceIndex(placeIndexStruct &places, double placeRadius);
+void rebuildTileIndex(subjectStruct &subj);
+int reduceSubject(vector<string> traceNames, const string &subject, const vector<runParamStruct> &params,
+                  const vector<string> &stateNames, unsigned threadCnt);
+int rescoreCorpus(const string &corpusDir, const vector<runParamStruct> &params);
+double roundDuraHours(double hours);
+void roundTripTotals(subjectStruct &subj);
+int runBenchmarks(const runParamStruct &param, const synthParamStruct &synth);
+int runStream(const vector<runParamStruct> &params, const string &stateDir, int checkpointSecs, const string &socketName);
+void runStays(dayStaysStruct &day);
+void scoreTrustBatch(const runParamStruct &param, trustBatchStruct &batch);
+void setLogLevel(ios_base &out, int level);
+vector<int> sortLocations(const mach2kStruct mach2kRec[], int machRecCnt);
+uint64_t stateChecksum(const mach2kStateStruct &header, const mach2kStruct mach2kRec[], const dwellHistStruct dwellHist[],
+                       const placeCenterStruct placeCenters[]);
+string streamStateName(const streamStruct &stream, const string &device, size_t paramIdx);
+mach2kTotalsStruct subjectTotals(const subjectStruct &subj);
+uint64_t synthRand(uint64_t &state);
+void tileCenter(int xTile, int yTile, double numTiles, double &lat, double &lon);
+uint64_t tileKey(int xTile, int yTile);
+int topLocations(const mach2kStruct mach2kRec[], int machRecCnt, int topCnt, int topIdx[]);
+double weekRegularity(const dwellHistStruct dwellHist[], int machRecCnt);
+string traceFileDateTime(const string &traceName);
+bool trustFactors(const runParamStruct &param, const mach2kTotalsStruct &totals, double factor[]);
+void welfordAdd(welfordStruct &acc, double value);
+void welfordMerge(welfordStruct &acc, const welfordStruct &other);
+int writeFileAtomic(const string &fileName, const string &bytes, bool keepBackup, ostream &logOut);
+int writeMach2kFile(const string &m2kName, const runParamStruct &param, subjectStruct &subj, ostream &logOut);
+int writeMach2kState(const string &stateName, const runParamStruct &param, const subjectStruct &subj, bool keepBackup,
+                     ostream &logOut);
+int writeRunStats(const string &statsName, const vector<runStatsStruct> &subjects, double wallSecs);
+int writeSynthTraces(const string &dirName, const synthParamStruct &synth, vector<string> &traceNames);
+int writeTraceCache(vector<string> traceNames, const string &cacheName, ostream &logOut);
+int writeVisitLog(vector<string> traceNames, const string &visitName, const runParamStruct &param, ostream &logOut);
+void writeTrustModel(ostream &modelOut, const runParamStruct &param, const trustStatsStruct &stats);
+
+#ifndef MACH2K_LIBRARY
+/** Heap allocations counted for --stats, on the threads it is on. An embedding program keeps its own operator new. **/
+void *operator new(size_t size)
+{
+    if (activeStats != nullptr)
+    {
+        activeStats->count[COUNT_ALLOCS] += 1;
+        activeStats->count[COUNT_ALLOC_BYTES] += size;
+    }
+    while (true)
+    {
+        void *mem = malloc((size > 0) ? size : 1);
+        if (mem != nullptr)
+            return mem;
+        new_handler handler = get_new_handler();
+        if (handler == nullptr)
+            throw bad_alloc();
+        handler();
+    }
+}
 
-                cout << "EOF: Updating MACH2K rec, mach2kTraceCnt=" << mach2kTraceCnt << ",qualTraceCnt=" << qualTraceCnt << endl;
+/** GCC takes free() of operator new memory for a mismatch once these are inlined, it is the pairing here **/
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *mem) noexcept
+{
+    free(mem);
+}
 
-                mach2kRec[bestMachRecIdx].traceCnt = to_string(mach2kTraceCnt); //No need for leading 0's, not sorting
-                cout << "EOF: After update, mach2kRec[bestMachRecIdx].traceCnt==" << mach2kRec[bestMachRecIdx].traceCnt << endl;
+void operator delete(void *mem, size_t) noexcept
+{
+    free(mem);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
-                qualTraceCnt = 0;
+int main(int argc, char *argv[])
+{
+    runParamStruct param;
+    vector<string> traceNames;                   // Daily GPS trace files to process, in date/time order
+    bool   multiDay = false;                     // true if argv[1] is a directory or @list file
+    string junkRec;
 
-                mach2kRec[bestMachRecIdx].lastYYYYMMDD = saveTraceRec.YYYYMMDD;
-                foundMachRec = true;
-                duraTime = 0.0;
-            } // updated existing MACH2K record
+//    cout << "About to do intial parameter count check" << endl;
 
-            /** Create new MACH2K record if still room in memory array of records **/
-            if (!foundMachRec)
+    /** --log-level=X, --trust-params=FILE, --place-radius=M and --stats=FILE (or with a space) and --split-days may **/
+    /** appear anywhere, remove them before the positional arguments                                                **/
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool trustArg = (arg.compare(0, 14, "--trust-params") == 0);
+        bool radiusArg = (arg.compare(0, 14, "--place-radius") == 0);
+        bool statsArg = (arg.compare(0, 7, "--stats") == 0);
+        bool splitArg = (arg == "--split-days");
+        if (!trustArg && !radiusArg && !statsArg && !splitArg && (arg.compare(0, 11, "--log-level") != 0))
+            continue;
+        size_t optionLen = (trustArg || radiusArg) ? 14 : statsArg ? 7 : 11;
+        int argCnt = (splitArg || (arg.size() > optionLen)) ? 1 : 2;
+        string value = (arg.size() > optionLen) ? arg.substr(optionLen + 1) : ((i + 1 < argc) ? argv[i + 1] : "");
+        if (splitArg)
+            param.splitDays = true;
+        else
+        if (statsArg)
+        {
+            if (((arg.size() > optionLen) && (arg[optionLen] != '=')) || value.empty())
             {
-                if (machRecCnt < MAX_MACH_REC_CNT - 1)
-                {
-                    mach2kRec[machRecCnt].xTile = to_string(xTileSave);
-                    mach2kRec[machRecCnt].yTile = to_string(yTileSave);
-
-        cout << "EOF: xTileSave=" << xTileSave << ",yTileSave=" << yTileSave << endl;
+                cout << "Invalid --stats " << value << ", use a report file name (.json or .csv)" << endl;
+                exit(1);
+            }
+            param.statsName = value;
+        }
+        else
+        if (radiusArg)
+        {
+            char *end = nullptr;
+            long radius = strtol(value.c_str(), &end, 10);
+            if (((arg.size() > optionLen) && (arg[optionLen] != '=')) || value.empty() || (*end != '\0') ||
+                (radius < 1) || (radius > 100000))
+            {
+                cout << "Invalid --place-radius " << value << ", use meters (1-100000)" << endl;
+                exit(1);
+            }
+            param.placeRadius = radius;
+        }
+        else
+        if (trustArg)
+        {
+            int status = ((arg.size() > optionLen) && (arg[optionLen] != '=')) ? 1 : readTrustModel(value, param.trust);
+            if (status == 1)
+                cout << "Invalid --trust-params " << value << endl;
+            if (status != 0)
+                exit(status);
+        }
+        else
+        {
+            int level;
+            if (((arg.size() > optionLen) && (arg[optionLen] != '=')) || !parseLogLevel(value, level))
+            {
+                cout << "Invalid --log-level " << value << ", use error, info, debug or trace" << endl;
+                exit(1);
+            }
+            if (level > MAX_LOG_LEVEL)
+                cout << "--log-level " << value << " is compiled out, rebuild with -DMAX_LOG_LEVEL=" << level << endl;
+            setLogLevel(cout, level);
+        }
+        for (int j = i; j + argCnt <= argc; j++)
+            argv[j] = argv[j + argCnt];
+        argc -= argCnt;
+        i -= 1;
+    }
 
-//                    mach2kRec[machRecCnt].hour = saveTraceHH;
-//                    mach2kRec[machRecCnt].dow = to_string(dow);
-                    mach2kRec[machRecCnt].hour = "99";
-                    mach2kRec[machRecCnt].dow = '9';
-                    mach2kRec[machRecCnt].freq = "001";
+    /** Export a binary state file in the MACH2K.txt layout for the spreadsheet workflow **/
+    if ((argc >= 3) && (string(argv[1]) == "-export-csv"))
+    {
+        string stateName = argv[2];
+        exit(exportMach2kFile(stateName, (argc > 3) ? string(argv[3]) : filesystem::path(stateName).replace_extension(".txt").string(),
+                              param.trust));
+    }
 
-                    if ((duraTime*24) < 10.0)
-                        mach2kRec[machRecCnt].dura = "00" + to_string(duraTime*24);
-                    else
-                        if ((duraTime*24) < 100.0)
-                            mach2kRec[machRecCnt].dura = '0' + to_string(duraTime*24);
-                        else
-                            if ((duraTime*24) < 1000.0)
-                                mach2kRec[machRecCnt].dura = to_string(duraTime*24);
-                    cout << "EOF: duraTime*24=" << duraTime*24 << ",mach2kRec.dura=" << mach2kRec[machRecCnt].dura << endl;
-                    //getchar();
+    /** Convert .plt files once into a trace cache, which later runs read instead: one trace directory, or every **/
+    /** NNN/trajectory directory of a GeoLife Data directory into its NNN.m2kc                                    **/
+    if ((argc >= 3) && (string(argv[1]) == "-make-cache"))
+    {
+        if (argc > 3)
+            exit(writeTraceCache(listTraceFiles(argv[2]), argv[3], cout));
+        vector<corpusSubjectStruct> corpus = listCorpusSubjects(argv[2]);
+        if (corpus.empty())
+        {
+            cout << "No NNN/trajectory subject directories found in " << argv[2] << endl;
+            exit(13);
+        }
+        for (const corpusSubjectStruct &subject : corpus)
+        {
+            int status = writeTraceCache(subject.traceNames,
+                                         (filesystem::path(subject.trajectoryDir) / (subject.subject + ".m2kc")).string(), cout);
+            if (status != 0)
+                exit(status);
+        }
+        exit(0);
+    }
 
-                    cout << "New MACH2K rec, qualTraceCnt=" << qualTraceCnt << ",to_string=" << to_string(qualTraceCnt) << endl;
+    /** Collapse a subject's trace files (or trace cache) once into the runs of each day at one zoom level, a visit log **/
+    /** later runs at that zoom level read instead                                                                         **/
+    if ((argc >= 5) && (string(argv[1]) == "-make-visits"))
+    {
+        vector<int> zoomLevels;
+        if (!parseZoomLevels(argv[4], zoomLevels) || (zoomLevels.size() != 1))
+        {
+            cout << "Invalid zoom level " << argv[4] << ", use one zoom level (1-21) per visit log" << endl;
+            exit(1);
+        }
+        if (param.placeRadius > 0)
+        {
+            cout << "A visit log holds tile runs, --place-radius stays depend on the traces in them" << endl;
+            exit(1);
+        }
+        param.zoomLevel = zoomLevels[0];
+        param.numTiles = pow(2,param.zoomLevel);
+        string inName = argv[2];
+        exit(writeVisitLog((filesystem::path(inName).extension() == ".m2kc") ? vector<string>(1, inName) : listTraceFiles(inName),
+                           argv[3], param, cout));
+    }
 
-                    mach2kRec[machRecCnt].traceCnt = to_string(qualTraceCnt);
-                    cout << "After to_string, mach2kRec[machRecCnt].traceCnt=" << mach2kRec[machRecCnt].traceCnt << endl;
+    /** Synthetic GeoLife-style traces, written to a directory or used for the stage benchmarks **/
+    if ((argc >= 3) && ((string(argv[1]) == "-gen-plt") || (string(argv[1]) == "-bench")))
+    {
+        bool bench = (string(argv[1]) == "-bench");
+        int  synthArg = bench ? 4 : 3;              // -bench has zoom level and secs. in place first
+        synthParamStruct synth;
+        if (argc > synthArg)
+            synth.daysCnt = atoi(argv[synthArg]);
+        if (argc > synthArg + 1)
+            synth.sampleSecs = atoi(argv[synthArg + 1]);
+        if (argc > synthArg + 2)
+            synth.placeCnt = atoi(argv[synthArg + 2]);
+        if (argc > synthArg + 3)
+            synth.spreadMeters = atof(argv[synthArg + 3]);
+        if (argc > synthArg + 4)
+            synth.seed = strtoull(argv[synthArg + 4], nullptr, 10);
+        if ((bench && (argc < 4)) || (synth.daysCnt < 1) || (synth.sampleSecs < 1) || (synth.placeCnt < 1) ||
+            !(synth.spreadMeters >= 0.0))
+        {
+            cout << "Usage: MACH2K -gen-plt [output directory] [days] [secs. between traces] [places] [spread meters] [seed]" << endl;
+            cout << "       MACH2K -bench [zoom level(1-21)] [secs. in place (900-3600)] [days] [secs. between traces] [places] [spread meters] [seed]" << endl;
+            exit(1);
+        }
+        if (!bench)
+        {
+            int status = writeSynthTraces(argv[2], synth, traceNames);
+            if (status == 0)
+                cout << "Wrote " << traceNames.size() << " synthetic trace files to " << argv[2] << endl;
+            exit(status);
+        }
+        param.version = argv[0];
+        param.zoomLevelStr = argv[2];
+        param.zoomLevel = atof(argv[2]);
+        param.numTiles = pow(2,param.zoomLevel);
+        param.durationStr = argv[3];
+        param.timeInPlace = atol(argv[3])/(24.0*60.0*60.0);
+        exit(runBenchmarks(param, synth));
+    }
 
-                    totQualTraceCnt += qualTraceCnt;
+    /** -reduce takes the same arguments as a subject run, plus threads **/
+    bool reduce = (argc >= 2) && (string(argv[1]) == "-reduce");
+    if (reduce)
+    {
+        for (int j = 1; j < argc; j++)
+            argv[j] = argv[j + 1];
+        argc -= 1;
+    }
 
-                    qualTraceCnt = 0;
+    /** Get input parameter count **/
+    if (argc < 5)
+    {
+        cout << "Usage: MACH2K [YYYYMMDDHHMMSS.plt | trace directory | @list file | NNN.m2kc | NNN_zZZ.m2kv] [3-digit userid]> [zoom level(s)] [secs. in place (900-3600)]"
+             << endl;   // If there are less than five arguments, stop the program
+        cout << "       MACH2K -corpus [GeoLife Data directory] [zoom level(s)] [secs. in place (900-3600)] [threads]" << endl;
+        cout << "       MACH2K -calibrate [GeoLife Data directory] [zoom level(s)] [secs. in place (900-3600)] [threads]" << endl;
+        cout << "       MACH2K -rescore [GeoLife Data directory] [zoom level(s)] [secs. in place (900-3600)]" << endl;
+        cout << "       MACH2K -reduce [trace directory | @list file] [3-digit userid] [zoom level(s)] [secs. in place (900-3600)] [threads]" << endl;
+        cout << "       MACH2K -stream [state directory] [zoom level(s)] [secs. in place (900-3600)] [checkpoint secs] [socket path]" << endl;
+        cout << "       MACH2K -export-csv [###_MACH2K.bin] [###_MACH2K.txt]" << endl;
+        cout << "       MACH2K -make-cache [trace directory] [NNN.m2kc] | -make-cache [GeoLife Data directory]" << endl;
+        cout << "       MACH2K -make-visits [trace directory | NNN.m2kc] [NNN_zZZ.m2kv] [zoom level(1-21)]" << endl;
+        cout << "       MACH2K -gen-plt [output directory] [days] [secs. between traces] [places] [spread meters] [seed]" << endl;
+        cout << "       MACH2K -bench [zoom level(1-21)] [secs. in place (900-3600)] [days] [secs. between traces] [places] [spread meters] [seed]" << endl;
+        cout << "       zoom level(s): 1-21, a list (12,14,16) or a range (12-20), one ###_MACH2K_zZZ file per zoom level" << endl;
+        cout << "       secs. in place: seconds or a list (900,1800,3600), one ###_MACH2K_sSSSS file per secs. in place" << endl;
+        cout << "       --log-level error|info|debug|trace may be added to any of the above" << endl;
+        cout << "       --trust-params MACH2K_trust.txt may be added to score TRUST with -calibrate constants" << endl;
+        cout << "       --place-radius meters may be added to count places as circles of that radius instead of tiles" << endl;
+        cout << "       --stats report.json|report.csv may be added to a subject, -reduce or -corpus run to time its stages" << endl;
+        cout << "       --split-days may be added to read trace files of any number of days, stays carried over midnight" << endl;
+        exit(1);
+    }
 
-                    mach2kRec[machRecCnt].firstYYYYMMDD = saveTraceRec.YYYYMMDD;
-                    mach2kRec[machRecCnt].lastYYYYMMDD = saveTraceRec.YYYYMMDD;
-                    machRecCnt += 1;
-                    duraTime = 0.0;
-                }
-                else
-                {
-                cout << "Error: More than " << MAX_MACH_REC_CNT << ' '<< argv[2] << "MACH2K.txt records." << endl;
-                exit(12);
-                }
-            } // end if no record for this location yet in MACH2K file
-        } // end if at least minimum time in same location after reading first record in changed location
-    }// at least some data qualifying for one more MACH2K record
+    /** Command line argv[3], to compare trace locations to saved mach2k.txt locations **/
+    param.version = argv[0];
+    param.zoomLevelStr = argv[3];
+    param.zoomLevel = atof(argv[3]);
+    param.numTiles = pow(2,param.zoomLevel);
+    /** Command line argv[4], to test for time in one place/location **/
+    /** !!! May want to restrict writing records of diff. duration requirements in same file !!! **/
+    /** May want to create header record with runtime parameters to ensure invalid combinations  **/
+    /** Seems like it's okay to add to a file using longer time requirements, but not shorter    **/
+    param.durationStr = argv[4];
+    param.timeInPlace = atol(argv[4])/(24.0*60.0*60.0);   // argv[4] in seconds, 3600sec. = 1hr., convert to fraction of day
+
+    /** argv[3] may be a list (12,14,16) or range (12-20) of zoom levels, each with its own MACH2K files **/
+    vector<int> zoomLevels;
+    if (!parseZoomLevels(argv[3], zoomLevels))
+    {
+        cout << "Invalid zoom level " << argv[3] << ", use 1-21, a list (12,14,16) or a range (12-20)." << endl;
+        exit(1);
+    }
+
+    /** argv[4] may be a list (900,1800,3600) of secs. in place, each zoom level is run at each of them **/
+    vector<int> durations;
+    if (!parseDurations(argv[4], durations))
+    {
+        cout << "Invalid secs. in place " << argv[4] << ", use seconds or a list (900,1800,3600)." << endl;
+        exit(1);
+    }
+    vector<runParamStruct> params;
+    for (size_t i = 0; i < zoomLevels.size(); i++)
+        for (size_t j = 0; j < durations.size(); j++)
+        {
+            params.push_back(param);
+            if (zoomLevels.size() > 1)
+            {
+                params.back().zoomLevelStr = to_string(zoomLevels[i]);
+                params.back().zoomLevel = zoomLevels[i];
+                params.back().numTiles = pow(2,params.back().zoomLevel);
+            }
+            if (durations.size() > 1)
+            {
+                params.back().durationStr = to_string(durations[j]);
+                params.back().timeInPlace = durations[j]/(24.0*60.0*60.0);
+            }
+        }
+
+    /** Corpus mode replaces driverv3.bat: every NNN/trajectory directory under argv[2], in parallel **/
+    string inName = argv[1];
+    if (inName == "-corpus")
+    {
+        unsigned threadCnt = (argc > 5) ? atoi(argv[5]) : thread::hardware_concurrency();
+        exit(processCorpus(argv[2], params, max(threadCnt, 1u)));
+    }
+
+    /** Calibrate derives the TRUST constants from the state files -corpus left in every NNN/trajectory directory **/
+    if (inName == "-calibrate")
+    {
+        unsigned threadCnt = (argc > 5) ? atoi(argv[5]) : thread::hardware_concurrency();
+        exit(calibrateTrust(argv[2], params, max(threadCnt, 1u)));
+    }
+
+    /** Rescore recomputes every subject's TRUST from its state file totals, with --trust-params, and ranks them **/
+    if (inName == "-rescore")
+        exit(rescoreCorpus(argv[2], params));
+
+    /** Stream mode keeps every device's state in memory and updates it fix by fix, from stdin or a Unix socket **/
+    if (inName == "-stream")
+        exit(runStream(params, argv[2], (argc > 5) ? atoi(argv[5]) : 300, (argc > 6) ? argv[6] : ""));
+
+    /** Build the list of input trace files: one file, every .plt file in a directory, or one name per line of an @list file **/
+    /** (a trace cache or visit log stands for the .plt files it was made from)                                              **/
+    error_code ec;
+    if ((filesystem::path(inName).extension() == ".m2kc") || (filesystem::path(inName).extension() == ".m2kv"))
+    {
+        multiDay = true;
+        traceNames.push_back(inName);
+    }
+    else
+    if (filesystem::is_directory(inName, ec))
+    {
+        multiDay = true;
+        traceNames = listTraceFiles(inName);
+    }
+    else
+    if (inName[0] == '@')
+    {
+        multiDay = true;
+        ifstream listFile(inName.substr(1));
+        if (!listFile)
+        {
+            cout << "Cannot open input list file " << inName.substr(1) << endl;
+            exit(2);
+        }
+        while (getline(listFile, junkRec))
+        {
+            if (!junkRec.empty() && junkRec.back() == '\r')
+                junkRec.pop_back();
+            if (!junkRec.empty())
+                traceNames.push_back(junkRec);
+        }
+    }
+    else
+        traceNames.push_back(inName);
+
+    if (multiDay)
+        cout << "input name=" << inName << ", trace files=" << traceNames.size() << endl;
+
+    /** Try to open an existing MACH2K state file from input parameter argv[2]: ###_MACH2K.bin (or ###_MACH2K.txt), **/
+    /** with _zZZ and/or _sSSSS added (see paramFileSuffix()) if there is more than one zoom level or secs. in place **/
+    string subject = argv[2];           // argv[2] is the acct# of person using the device
+    vector<string> outNames;
+    for (size_t i = 0; i < params.size(); i++)
+        outNames.push_back(subject + "_MACH2K" + paramFileSuffix(params, i) + ".bin");
+
+    /** Single file: open errors are reported before looking at MACH2K.txt, as before **/
+    if (!multiDay && !reduce)
+    {
+        ifstream inFile(traceNames[0]);
+        if (!inFile)
+        {
+            cout << "Cannot open input file" << traceNames[0] << endl;
+            exit(2);
+        }
+    }
+
+    /** --stats are kept by the thread(s) doing the work and reported once the run ends, whatever its status **/
+    int status;
+    runStatsStruct stats;
+    stats.subject = subject;
+    auto runStart = chrono::steady_clock::now();
+    if (reduce)
+    {
+        /** Days summarized on threads and merged, into NNN_MACH2K.part as well as the state file **/
+        unsigned threadCnt = (argc > 5) ? atoi(argv[5]) : thread::hardware_concurrency();
+        activeStats = param.statsName.empty() ? nullptr : &stats;
+        status = reduceSubject(traceNames, subject, params, outNames, max(threadCnt, 1u));
+        activeStats = nullptr;
+    }
+    else
+    {
+        /** Log lines are buffered and written by a background thread, the buffer is flushed on return **/
+        asyncLogBuf logBuf(cout.rdbuf());
+        ostream logOut(&logBuf);
+        setLogLevel(logOut, logLevel(cout));
+        mach2kEngine engine(params, subject, logOut);
+        activeStats = param.statsName.empty() ? nullptr : &stats;
+        status = processSubject(traceNames, multiDay, outNames, engine, logOut);
+        activeStats = nullptr;
+    }
+    if (!param.statsName.empty())
+    {
+        stats.wallSecs = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+        stats.peakRssKB = peakRssKB();
+        int statsStatus = writeRunStats(param.statsName, vector<runStatsStruct>(1, stats), stats.wallSecs);
+        if (status == 0)
+            status = statsStatus;
+    }
+    if (status != 0)
+        exit(status);
+
+    return 0;
+} // end main
+#endif
+
+/**
+*
+* Read the subject's binary state file (or, the first time, a MACH2K.txt of the same name),
+* apply each daily trace file in date/time order and write the state file once at the end.
+* There is one state file per engine params entry (zoom level and secs. in place); all of them
+* are updated from the same read of each trace file. With multiDay, files that m2k.bat
+* would skip (cannot open, already processed date) are skipped. Returns 0 or the program
+* exit code.
+*
+**/
+int processSubject(vector<string> traceNames, bool multiDay, const vector<string> &stateNames,
+                   mach2kEngine &engine, ostream &logOut)
+{
+    int status = 0;
+
+    /** Process days in the order of the date/time in the file name, the same order as m2k.bat **/
+    stable_sort(traceNames.begin(), traceNames.end(),
+                [](const string &a, const string &b) { return traceFileDateTime(a) < traceFileDateTime(b); });
+
+    for (size_t z = 0; z < engine.paramCnt(); z++)
+    {
+        runParamStruct fileParam = engine.param(z);
+        status = readMach2kState(stateNames[z], fileParam, engine.subject(z), logOut);
+        if (status != 0)
+            return status;
+        if (!engine.subject(z).m2kLoaded)
+        {
+            status = readMach2kFile(filesystem::path(stateNames[z]).replace_extension(".txt").string(), engine.param(z),
+                                    engine.subject(z), logOut);
+            if (status != 0)
+                return status;
+        }
+    }
+
+    /** Apply each day to the in-memory MACH2K totals and records, rounded between days by the engine **/
+    bool splitDays = engine.param(0).splitDays;
+    int daysProcessed = 0;
+    traceCacheStruct cache;
+    vector<traceStruct> cacheRecs;
+    visitLogStruct visits;
+    dayStaysStruct visitStays;
+    for (size_t i = 0; i < traceNames.size(); i++)
+    {
+        /** A trace cache or visit log is the days of the trace files it was made from, each handled the same as its file **/
+        bool isCache = (filesystem::path(traceNames[i]).extension() == ".m2kc");
+        bool isVisits = (filesystem::path(traceNames[i]).extension() == ".m2kv");
+        uint32_t dayCnt = 1;
+        if ((isCache || isVisits) && splitDays)
+        {
+            logAt(LOG_ERROR, logOut) << "--split-days reads .plt files, a trace cache or visit log has only the first date of each file: "
+                                     << traceNames[i] << endl;
+            return 1;
+        }
+        if (isCache)
+        {
+            status = openTraceCache(traceNames[i], cache, logOut);
+            if (status != 0)
+                return status;
+            dayCnt = cache.header.dayCnt;
+        }
+        if (isVisits)
+        {
+            status = openVisitLog(traceNames[i], visits, logOut);
+            if (status != 0)
+                return status;
+            for (size_t z = 0; z < engine.paramCnt(); z++)
+                if ((engine.param(z).zoomLevel != visits.header.zoomLevel) || (engine.param(z).placeRadius > 0) ||
+                    (engine.param(z).requiredTraceInterval != visits.header.requiredTraceInterval))
+                {
+                    logAt(LOG_ERROR, logOut) << "Visit log " << traceNames[i] << " holds the tile runs of zoom level "
+                         << visits.header.zoomLevel << ", the run must be at that zoom level alone, without --place-radius." << endl;
+                    return 4;
+                }
+            dayCnt = visits.header.dayCnt;
+        }
+
+        for (uint32_t d = 0; d < dayCnt; d++)
+        {
+            string dayName = isCache ? (traceNames[i] + ':' + cache.days[d].fileNameDateTime) :
+                             isVisits ? (traceNames[i] + ':' + visits.days[d].fileNameDateTime) : traceNames[i];
+            status = isCache ? processCacheDay(cache, d, engine, cacheRecs, logOut) :
+                     isVisits ? processVisitDay(visits, d, engine, visitStays, logOut) :
+                     splitDays ? processTraceStream(traceNames[i], engine, logOut) : processTraceFile(traceNames[i], engine, logOut);
+            if (status == 0)
+                daysProcessed += 1;
+            else
+            if (!multiDay)
+                return status;
+            else
+            if ((status == 2) || (status == 6))      // file skipped, same as m2k.bat going on to the next file
+                logAt(LOG_INFO, logOut) << "Skipping " << dayName << ", status=" << status << endl;
+            else
+            {
+                logAt(LOG_ERROR, logOut) << "Stopping at " << dayName << ", status=" << status << ", MACH2K file not updated." << endl;
+                return status;
+            }
+        }
+    } // for each trace file
+    engine.endDay();                    // with --split-days, the last date read is still open
+
+    /** The state the run started from is kept as NNN_MACH2K.bin.bak **/
+    if (daysProcessed > 0)
+        for (size_t z = 0; z < engine.paramCnt(); z++)
+        {
+            status = writeMach2kState(stateNames[z], engine.param(z), engine.subject(z), true, logOut);
+            if (status != 0)
+                return status;
+        }
+
+    return 0;
+}
+
+/**
+*
+* Process every subject directory NNN/trajectory under corpusDir, the same as driverv3.bat
+* (old NNN_MACH2K.txt and mach2ktile.log are replaced), but on threadCnt threads. Each
+* subject's NNN_MACH2K.bin state is rebuilt and exported as NNN_MACH2K.txt.
+* Subjects are independent, so they are queued biggest first (total .plt bytes) round
+* robin over the threads; a thread that runs out of work steals from the back of
+* another thread's queue. Wall time and traces/sec are reported for every subject.
+* Returns 0, or 13 if corpusDir has no subjects, or 14 if any subject failed.
+*
+**/
+int processCorpus(const string &corpusDir, const vector<runParamStruct> &params, unsigned threadCnt)
+{
+    vector<corpusSubjectStruct> corpus = listCorpusSubjects(corpusDir);
+    if (corpus.empty())
+    {
+        cout << "No NNN/trajectory subject directories found in " << corpusDir << endl;
+        return 13;
+    }
+
+    /** A subject's NNN.m2kc trace cache (see -make-cache) is read instead of its .plt files **/
+    size_t cachedCnt = 0;
+    for (corpusSubjectStruct &subject : corpus)
+    {
+        error_code cacheEc;
+        string cacheName = (filesystem::path(subject.trajectoryDir) / (subject.subject + ".m2kc")).string();
+        if (filesystem::is_regular_file(cacheName, cacheEc))
+        {
+            subject.traceNames.assign(1, cacheName);
+            cachedCnt += 1;
+        }
+    }
+
+    /** Biggest subjects first so a large subject doesn't start last and become the straggler **/
+    sort(corpus.begin(), corpus.end(),
+         [](const corpusSubjectStruct &a, const corpusSubjectStruct &b)
+         { return (a.traceBytes != b.traceBytes) ? (a.traceBytes > b.traceBytes) : (a.subject < b.subject); });
+
+    threadCnt = min<unsigned>(threadCnt, corpus.size());
+    vector<workQueueStruct> workQueue(threadCnt);
+    for (size_t i = 0; i < corpus.size(); i++)
+        workQueue[i % threadCnt].tasks.push_back(i);
+
+    cout << "Processing " << corpus.size() << " subjects (" << cachedCnt << " from trace caches) on " << threadCnt << " threads" << endl;
+
+    mutex coutLock;
+    auto corpusStart = chrono::steady_clock::now();
+    auto worker = [&](unsigned self)
+    {
+        size_t task;
+        while (nextCorpusTask(workQueue, self, task))
+        {
+            corpusSubjectStruct &subject = corpus[task];
+            vector<string> m2kNames, stateNames;
+            error_code removeEc;
+            for (size_t z = 0; z < params.size(); z++)
+            {
+                string baseName = subject.subject + "_MACH2K" + paramFileSuffix(params, z);
+                m2kNames.push_back((filesystem::path(subject.trajectoryDir) / (baseName + ".txt")).string());
+                stateNames.push_back((filesystem::path(subject.trajectoryDir) / (baseName + ".bin")).string());
+                filesystem::remove(m2kNames[z], removeEc);      // same as driverv3.bat: del NNN_mach2k.txt
+                filesystem::remove(stateNames[z], removeEc);
+            }
+            string logName = (filesystem::path(subject.trajectoryDir) / "mach2ktile.log").string();
+            ofstream logFile(logName);                  // same as driverv3.bat: del mach2ktile.log
+            asyncLogBuf logBuf(logFile.rdbuf());
+            ostream logOut(&logBuf);
+            setLogLevel(logOut, logLevel(cout));
+
+            auto subjectStart = chrono::steady_clock::now();
+            activeStats = params[0].statsName.empty() ? nullptr : &subject.stats;
+            mach2kEngine engine(params, subject.subject, logOut);
+            subject.status = processSubject(subject.traceNames, true, stateNames, engine, logOut);
+            for (size_t z = 0; (z < params.size()) && (subject.status == 0); z++)
+                if (engine.subject(z).m2kLoaded)
+                    subject.status = writeMach2kFile(m2kNames[z], params[z], engine.subject(z), logOut);
+            activeStats = nullptr;
+            subject.wallSecs = chrono::duration<double>(chrono::steady_clock::now() - subjectStart).count();
+            subject.stats.subject = subject.subject;
+            subject.stats.wallSecs = subject.wallSecs;
+            subject.stats.peakRssKB = peakRssKB();
+            subject.daysCnt = engine.subject(0).totDaysCnt;
+            subject.traceRecCnt = engine.subject(0).traceRecCnt;
+
+            lock_guard<mutex> guard(coutLock);
+            cout << "Subject " << subject.subject << ": status=" << subject.status << ", days=" << subject.daysCnt
+                 << ", traces=" << subject.traceRecCnt << ", secs=" << subject.wallSecs
+                 << ", traces/sec=" << ((subject.wallSecs > 0) ? subject.traceRecCnt/subject.wallSecs : 0) << endl;
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 0; i < threadCnt; i++)
+        threads.emplace_back(worker, i);
+    for (thread &t : threads)
+        t.join();
+    double corpusSecs = chrono::duration<double>(chrono::steady_clock::now() - corpusStart).count();
+
+    /** Report slowest subjects first to spot stragglers **/
+    sort(corpus.begin(), corpus.end(),
+         [](const corpusSubjectStruct &a, const corpusSubjectStruct &b) { return a.wallSecs > b.wallSecs; });
+
+    int    failedCnt = 0;
+    double totTraceRecCnt = 0.0;
+    cout << "Subject,Status,Days,Trace Cnt,Trace Bytes,Wall Secs,Traces/Sec\n";
+    for (const corpusSubjectStruct &subject : corpus)
+    {
+        cout << subject.subject << ',' << subject.status << ',' << subject.daysCnt << ','
+             << subject.traceRecCnt << ',' << subject.traceBytes << ',' << subject.wallSecs << ','
+             << ((subject.wallSecs > 0) ? subject.traceRecCnt/subject.wallSecs : 0) << '\n';
+        totTraceRecCnt += subject.traceRecCnt;
+        if (subject.status != 0)
+            failedCnt += 1;
+    }
+    cout << "Corpus: subjects=" << corpus.size() << ", failed=" << failedCnt << ", threads=" << threadCnt
+         << ", secs=" << corpusSecs << ", traces/sec=" << ((corpusSecs > 0) ? totTraceRecCnt/corpusSecs : 0) << endl;
+
+    /** --stats report, a row per subject (slowest first, as above) and the corpus totals **/
+    if (!params[0].statsName.empty())
+    {
+        vector<runStatsStruct> subjectStats;
+        for (const corpusSubjectStruct &subject : corpus)
+            subjectStats.push_back(subject.stats);
+        int status = writeRunStats(params[0].statsName, subjectStats, corpusSecs);
+        if (status != 0)
+            return status;
+    }
+
+    return (failedCnt > 0) ? 14 : 0;
+}
+
+/**
+*
+* Every NNN/trajectory subject directory under corpusDir, with its .plt files and their total size.
+* The trajectory directory's name is matched in any case (GeoLife has NNN/Trajectory).
+*
+**/
+vector<corpusSubjectStruct> listCorpusSubjects(const string &corpusDir)
+{
+    vector<corpusSubjectStruct> corpus;
+    error_code ec;
+
+    for (const auto &entry : filesystem::directory_iterator(corpusDir, ec))
+    {
+        string dirName = entry.path().filename().string();
+        if (dirName.empty() || (dirName.find_first_not_of("0123456789") != string::npos) ||
+            !entry.is_directory(ec))
+            continue;
+        filesystem::path trajectoryDir;
+        for (const auto &subEntry : filesystem::directory_iterator(entry.path(), ec))
+        {
+            string subName = subEntry.path().filename().string();
+            transform(subName.begin(), subName.end(), subName.begin(), [](unsigned char c) { return tolower(c); });
+            if ((subName == "trajectory") && subEntry.is_directory(ec))
+            {
+                trajectoryDir = subEntry.path();
+                break;
+            }
+        }
+        if (trajectoryDir.empty())
+            continue;
+
+        corpusSubjectStruct subject;
+        subject.subject = dirName;
+        subject.trajectoryDir = trajectoryDir.string();
+        subject.traceNames = listTraceFiles(subject.trajectoryDir);
+        for (const string &traceName : subject.traceNames)
+            subject.traceBytes += filesystem::file_size(traceName, ec);
+        corpus.push_back(subject);
+    }
+    return corpus;
+}
+
+/**
+*
+* -calibrate: population statistics of the TRUST factors (see trustFactors()) over the state
+* file each NNN/trajectory subject has for each params entry, as left by -corpus with the same
+* zoom levels and secs. in place. The subjects are read on threadCnt threads, each adding to its
+* own statistics, merged at the end. Writes MACH2K_trust.txt (with paramFileSuffix()) to
+* corpusDir for each params entry. Returns 0, 13 if there are no subject directories, 14 if a
+* params entry has fewer than 2 subjects with a TRUST, or 9 if a file cannot be written.
+*
+**/
+int calibrateTrust(const string &corpusDir, const vector<runParamStruct> &params, unsigned threadCnt)
+{
+    vector<corpusSubjectStruct> corpus = listCorpusSubjects(corpusDir);
+    if (corpus.empty())
+    {
+        cout << "No NNN/trajectory subject directories found in " << corpusDir << endl;
+        return 13;
+    }
+
+    threadCnt = min<unsigned>(threadCnt, corpus.size());
+    vector<workQueueStruct> workQueue(threadCnt);
+    for (size_t i = 0; i < corpus.size(); i++)
+        workQueue[i % threadCnt].tasks.push_back(i);
+
+    cout << "Calibrating from " << corpus.size() << " subjects on " << threadCnt << " threads" << endl;
+
+    mutex coutLock;
+    auto calibrateStart = chrono::steady_clock::now();
+    vector<vector<trustStatsStruct>> threadStats(threadCnt, vector<trustStatsStruct>(params.size()));
+    auto worker = [&](unsigned self)
+    {
+        size_t task;
+        while (nextCorpusTask(workQueue, self, task))
+        {
+            const corpusSubjectStruct &subject = corpus[task];
+            for (size_t z = 0; z < params.size(); z++)
+            {
+                trustStatsStruct &stats = threadStats[self][z];
+                string stateName = (filesystem::path(subject.trajectoryDir) /
+                                    (subject.subject + "_MACH2K" + paramFileSuffix(params, z) + ".bin")).string();
+                runParamStruct fileParam = params[z];
+                subjectStruct subj;
+                ostringstream logOut;           // only the errors, written if the state is not read
+                setLogLevel(logOut, LOG_ERROR);
+                if (readMach2kState(stateName, fileParam, subj, logOut) != 0)
+                {
+                    stats.failedCnt += 1;
+                    lock_guard<mutex> guard(coutLock);
+                    cout << logOut.str();
+                    continue;
+                }
+
+                /** Only subjects with a TRUST are part of the population **/
+                double factor[TRUST_FACTOR_CNT];
+                bool scored = subj.m2kLoaded && trustFactors(params[z], subjectTotals(subj), factor);
+                for (int f = 0; scored && (f < TRUST_FACTOR_CNT); f++)
+                    scored = isfinite(factor[f]);
+                if (!scored)
+                {
+                    stats.skippedCnt += 1;
+                    continue;
+                }
+                stats.subjectCnt += 1;
+                for (int f = 0; f < TRUST_FACTOR_CNT; f++)
+                {
+                    welfordAdd(stats.factor[f], factor[f]);
+                    stats.values[f].push_back(factor[f]);
+                }
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 0; i < threadCnt; i++)
+        threads.emplace_back(worker, i);
+    for (thread &t : threads)
+        t.join();
+
+    int status = 0;
+    for (size_t z = 0; z < params.size(); z++)
+    {
+        trustStatsStruct stats;
+        for (vector<trustStatsStruct> &perThread : threadStats)
+        {
+            const trustStatsStruct &part = perThread[z];
+            stats.subjectCnt += part.subjectCnt;
+            stats.skippedCnt += part.skippedCnt;
+            stats.failedCnt += part.failedCnt;
+            for (int f = 0; f < TRUST_FACTOR_CNT; f++)
+            {
+                welfordMerge(stats.factor[f], part.factor[f]);
+                stats.values[f].insert(stats.values[f].end(), part.values[f].begin(), part.values[f].end());
+            }
+        }
+        for (int f = 0; f < TRUST_FACTOR_CNT; f++)
+            sort(stats.values[f].begin(), stats.values[f].end());
+
+        cout << "zoom level=" << params[z].zoomLevelStr << ", seconds=" << params[z].durationStr << ": subjects="
+             << stats.subjectCnt << ", skipped=" << stats.skippedCnt << ", failed=" << stats.failedCnt << endl;
+        if (stats.subjectCnt < 2)
+        {
+            cout << "Too few subjects with a TRUST to calibrate, run -corpus with the same zoom level and secs. in place first" << endl;
+            status = 14;
+            continue;
+        }
+
+        string modelName = (filesystem::path(corpusDir) / ("MACH2K_trust" + paramFileSuffix(params, z) + ".txt")).string();
+        ofstream modelFile(modelName);
+        writeTrustModel(modelFile, params[z], stats);
+        modelFile.close();
+        if (!modelFile)
+        {
+            cout << "Error creating and opening output file " << modelName << endl;
+            status = 9;
+            continue;
+        }
+        writeTrustModel(cout, params[z], stats);
+        cout << "Wrote " << modelName << endl;
+    }
+    cout << "Calibrate: secs=" << chrono::duration<double>(chrono::steady_clock::now() - calibrateStart).count() << endl;
+    return status;
+}
+
+/**
+*
+* -rescore: TRUST of every NNN/trajectory subject under corpusDir from the totals in its state
+* file header (the MACH2K.txt summary row), with param.trust (--trust-params), for each params
+* entry. No trace file and no location record is read: the subjects are loaded into a
+* trustBatchStruct and scored in one pass (see scoreTrustBatch()). Writes the subjects ranked
+* by TRUST to MACH2K_rescore.csv (with paramFileSuffix()) in corpusDir. Returns 0, 13 if there
+* are no subject directories, 14 if a state file could not be read, or 9 if a file cannot be
+* written.
+*
+**/
+int rescoreCorpus(const string &corpusDir, const vector<runParamStruct> &params)
+{
+    vector<corpusSubjectStruct> corpus = listCorpusSubjects(corpusDir);
+    if (corpus.empty())
+    {
+        cout << "No NNN/trajectory subject directories found in " << corpusDir << endl;
+        return 13;
+    }
+    sort(corpus.begin(), corpus.end(),
+         [](const corpusSubjectStruct &a, const corpusSubjectStruct &b) { return a.subject < b.subject; });
+
+    int status = 0;
+    for (size_t z = 0; z < params.size(); z++)
+    {
+        auto loadStart = chrono::steady_clock::now();
+        trustBatchStruct batch;
+        int skippedCnt = 0, failedCnt = 0;
+        for (const corpusSubjectStruct &subject : corpus)
+        {
+            string stateName = (filesystem::path(subject.trajectoryDir) /
+                                (subject.subject + "_MACH2K" + paramFileSuffix(params, z) + ".bin")).string();
+            mach2kTotalsStruct totals;
+            int readStatus = readStateTotals(stateName, params[z], totals, cout);
+            if (readStatus == 2)
+                skippedCnt += 1;
+            else
+            if (readStatus != 0)
+                failedCnt += 1;
+            else
+                addTrustBatch(batch, subject.subject, totals);
+        }
+        auto scoreStart = chrono::steady_clock::now();
+        scoreTrustBatch(params[z], batch);
+        auto scoreEnd = chrono::steady_clock::now();
+
+        /** Highest TRUST first, subjects with the same TRUST in subject order **/
+        vector<size_t> rank(batch.subject.size());
+        for (size_t i = 0; i < rank.size(); i++)
+            rank[i] = i;
+        stable_sort(rank.begin(), rank.end(), [&batch](size_t a, size_t b) { return batch.trust[a] > batch.trust[b]; });
+
+        ostringstream table;
+        table << "Rank,Subject,TRUST,Tot days,Tot hrs,Tot locs,Qual locs,Tot qual hrs,Tot qual days\n";
+        for (size_t r = 0; r < rank.size(); r++)
+        {
+            size_t i = rank[r];
+            table << (r + 1) << ',' << batch.subject[i] << ',' << batch.trust[i] << ',' << batch.totDaysCnt[i] << ','
+                  << batch.totHrsCnt[i] << ',' << batch.totLocsCnt[i] << ',' << batch.machRecCnt[i] << ','
+                  << batch.totQualDura[i] << ',' << batch.totQualDaysCnt[i] << '\n';
+        }
+        string tableName = (filesystem::path(corpusDir) / ("MACH2K_rescore" + paramFileSuffix(params, z) + ".csv")).string();
+        if (writeFileAtomic(tableName, table.str(), false, cout) != 0)
+        {
+            status = 9;
+            continue;
+        }
+        if (failedCnt > 0)
+            status = 14;
+
+        cout << "zoom level=" << params[z].zoomLevelStr << ", seconds=" << params[z].durationStr << ": subjects="
+             << batch.subject.size() << ", skipped=" << skippedCnt << ", failed=" << failedCnt << ", load secs="
+             << chrono::duration<double>(scoreStart - loadStart).count() << ", score secs="
+             << chrono::duration<double>(scoreEnd - scoreStart).count() << endl;
+        cout << "Wrote " << tableName << endl;
+    }
+    return status;
+}
+
+/**
+*
+* Read the totals of a binary state file's header, the inputs of its TRUST (see machTrust()),
+* without its records. The checksum is not tested, it needs the records. Returns 0, 2 if there
+* is no state file, or the readMach2kState() exit codes.
+*
+**/
+int readStateTotals(const string &stateName, const runParamStruct &param, mach2kTotalsStruct &totals, ostream &logOut)
+{
+    mach2kStateStruct header;
+    ifstream stateFile(stateName, ios::binary);
+    if (!stateFile)
+        return 2;
+    if (!stateFile.read((char *)&header, sizeof(header)) || (memcmp(header.magic, M2K_STATE_MAGIC, sizeof(header.magic)) != 0))
+    {
+        logAt(LOG_ERROR, logOut) << "Invalid MACH2K state file " << stateName << ", no MACH2K header." << endl;
+        return 3;
+    }
+    if ((header.version < 1) || (header.version > M2K_STATE_VERSION) || (header.recSize != sizeof(mach2kStruct)))
+    {
+        logAt(LOG_ERROR, logOut) << "MACH2K state file " << stateName << " is version " << header.version
+               << ", this program reads version " << M2K_STATE_VERSION << ". Rebuild it from the trace files." << endl;
+        return 3;
+    }
+    if (header.version < 3)
+        header.placeRadius = 0;                                             // was spare, always 0
+    if ((param.zoomLevelStr != header.zoomLevelStr) || (param.durationStr != header.durationStr) ||
+        ((uint32_t)param.placeRadius != header.placeRadius))
+    {
+        logAt(LOG_ERROR, logOut) << "MACH2K state file " << stateName << " is zoom level " << header.zoomLevelStr
+               << ", seconds " << header.durationStr << ", not " << param.zoomLevelStr << ", " << param.durationStr << "." << endl;
+        return (param.durationStr == header.durationStr) ? 4 : 5;
+    }
+
+    totals.totDaysCnt = header.totDaysCnt;
+    totals.totHrsCnt = header.totHrsCnt;
+    totals.totLocsCnt = header.totLocsCnt;
+    totals.totQualDura = header.totQualDura;
+    totals.totQualDaysCnt = header.totQualDaysCnt;
+    totals.minXtile = header.minXtile;
+    totals.minYtile = header.minYtile;
+    totals.maxXtile = header.maxXtile;
+    totals.maxYtile = header.maxYtile;
+    totals.machRecCnt = header.machRecCnt;
+    return 0;
+}
+
+/**
+*
+* Add one subject's TRUST inputs to the end of a -rescore batch
+*
+**/
+void addTrustBatch(trustBatchStruct &batch, const string &subject, const mach2kTotalsStruct &totals)
+{
+    int minXtile = (totals.minXtile == 999999) ? 0 : totals.minXtile;      // as trustFactors()
+
+    batch.subject.push_back(subject);
+    batch.totDaysCnt.push_back(totals.totDaysCnt);
+    batch.totHrsCnt.push_back(totals.totHrsCnt);
+    batch.totLocsCnt.push_back(totals.totLocsCnt);
+    batch.totQualDura.push_back(totals.totQualDura);
+    batch.totQualDaysCnt.push_back(totals.totQualDaysCnt);
+    batch.machRecCnt.push_back(totals.machRecCnt);
+    batch.xSpan.push_back(totals.maxXtile - minXtile + 1);
+    batch.ySpan.push_back(totals.maxYtile - totals.minYtile + 1);
+}
+
+/**
+*
+* Set batch.trust to every subject's TRUST under param's model, the same values as machTrust(),
+* SIMD_WIDTH subjects at a time. Each lane does machTrust()'s operations in its order; the TRUST=0
+* tests and the days ramp are selects, so there are no branches per subject.
+*
+**/
+void scoreTrustBatch(const runParamStruct &param, trustBatchStruct &batch)
+{
+    const trustModelStruct &trust = param.trust;
+    size_t count = batch.subject.size();
+    double tileLength = param.tileLength;
+    batch.trust.resize(count);
+
+    size_t i = 0;
+#ifdef SIMD_WIDTH
+    for ( ; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        simdDouble totDaysCnt = simdLoad(&batch.totDaysCnt[i]);
+        simdDouble totQualDura = simdLoad(&batch.totQualDura[i]);
+        simdDouble totQualDaysCnt = simdLoad(&batch.totQualDaysCnt[i]);
+        simdDouble machRecCnt = simdLoad(&batch.machRecCnt[i]);
+        simdDouble boundArea = simdMul(simdMul(simdLoad(&batch.xSpan[i]), simdSet(tileLength)),
+                                       simdMul(simdLoad(&batch.ySpan[i]), simdSet(tileLength)));
+        simdDouble factor[TRUST_FACTOR_CNT];
+        factor[0] = simdDiv(totQualDura, totQualDaysCnt);
+        factor[1] = simdDiv(machRecCnt, totQualDaysCnt);
+        factor[2] = simdDiv(totQualDaysCnt, totDaysCnt);
+        factor[3] = simdDiv(machRecCnt, simdLoad(&batch.totLocsCnt[i]));
+        factor[4] = simdDiv(totQualDura, simdLoad(&batch.totHrsCnt[i]));
+        factor[5] = simdDiv(simdMul(machRecCnt, simdSet(trust.tileArea)), boundArea);
+
+        simdDouble score = simdSet(0.0);
+        for (int f = 0; f < TRUST_FACTOR_CNT; f++)
+            score = simdAdd(score, simdMul(simdSet(trust.weight[f]), simdDiv(factor[f], simdSet(trust.norm[f]))));
+        score = simdSelect(simdGreater(simdSet(trust.fullDays), totDaysCnt),
+                           simdMul(score, simdDiv(totDaysCnt, simdSet(trust.fullDays))), score);
+
+        /** machRecCnt is a whole number, so > minQualLocs - 0.5 is >= minQualLocs **/
+        simdDouble scored = simdAnd(simdAnd(simdGreater(totDaysCnt, simdSet(0.0)), simdGreater(simdSet(trust.maxArea), boundArea)),
+                                    simdGreater(machRecCnt, simdSet(trust.minQualLocs - 0.5)));
+        simdStore(&batch.trust[i], simdSelect(scored, score, simdSet(0.0)));
+    }
+#endif
+    for ( ; i < count; i++)
+    {
+        mach2kTotalsStruct totals;
+        totals.totDaysCnt = batch.totDaysCnt[i];
+        totals.totHrsCnt = batch.totHrsCnt[i];
+        totals.totLocsCnt = batch.totLocsCnt[i];
+        totals.totQualDura = batch.totQualDura[i];
+        totals.totQualDaysCnt = batch.totQualDaysCnt[i];
+        totals.machRecCnt = (int)batch.machRecCnt[i];
+        totals.minXtile = totals.minYtile = 0;
+        totals.maxXtile = (int)batch.xSpan[i] - 1;
+        totals.maxYtile = (int)batch.ySpan[i] - 1;
+        batch.trust[i] = machTrust(param, totals);
+    }
+}
+
+/**
+*
+* Write a trust parameters file (see readTrustModel()) from -calibrate statistics: each
+* factor's new norm is its mean + 1 std dev, the weights and limits are param.trust's. The
+* factor values in stats must be sorted, the percentiles are nearest rank.
+*
+**/
+void writeTrustModel(ostream &modelOut, const runParamStruct &param, const trustStatsStruct &stats)
+{
+    const trustModelStruct &trust = param.trust;
+    auto percentile = [](const vector<double> &values, double pct)
+    {
+        size_t rank = (size_t)ceil(pct/100.0 * values.size());
+        return values[(rank > 0) ? rank - 1 : 0];
+    };
+
+    modelOut << "MACH2K trust parameters,zoom level=" << param.zoomLevelStr << ",seconds=" << param.durationStr
+             << ",subjects=" << stats.subjectCnt << ",version=" << param.version << '\n';
+    modelOut << "Factor,Weight,Norm,Mean,Std Dev,Min,P10,P50,P90,Max\n";
+    for (int f = 0; f < TRUST_FACTOR_CNT; f++)
+    {
+        const welfordStruct &acc = stats.factor[f];
+        double stdDev = sqrt(acc.m2/(acc.count - 1.0));         // sample std dev, as the spreadsheet's STDEV
+        modelOut << TRUST_FACTOR_NAMES[f] << ',' << trust.weight[f] << ',' << (acc.mean + stdDev) << ','
+                 << acc.mean << ',' << stdDev << ',' << acc.min << ',' << percentile(stats.values[f], 10.0) << ','
+                 << percentile(stats.values[f], 50.0) << ',' << percentile(stats.values[f], 90.0) << ',' << acc.max << '\n';
+    }
+    modelOut << "Tile Area km^2," << trust.tileArea << '\n';
+    modelOut << "Max Area km^2," << trust.maxArea << '\n';
+    modelOut << "Min Qual Locs," << trust.minQualLocs << '\n';
+    modelOut << "Full Days," << trust.fullDays << '\n';
+    modelOut.flush();
+}
+
+/**
+*
+* Load a trust parameters file written by -calibrate (or edited by hand) into trust: a
+* "Factor,Weight,Norm" row for each TRUST_FACTOR_NAMES factor (any more columns are the
+* statistics, not read) and a name,value row for each limit. Rows not in the file keep their
+* current values. Returns 0, 2 if the file cannot be opened or 3 if a row is not valid.
+*
+**/
+int readTrustModel(const string &modelName, trustModelStruct &trust)
+{
+    ifstream modelFile(modelName);
+    if (!modelFile)
+    {
+        cout << "Cannot open trust parameters file " << modelName << endl;
+        return 2;
+    }
+
+    string line;
+    for (int lineNum = 1; getline(modelFile, line); lineNum++)
+    {
+        if (!line.empty() && (line.back() == '\r'))
+            line.pop_back();
+        vector<string> field;
+        stringstream lineStream(line);
+        string fieldStr;
+        while (getline(lineStream, fieldStr, ','))
+            field.push_back(fieldStr);
+
+        bool valid = true;
+        auto number = [&](size_t idx)
+        {
+            char *end = nullptr;
+            double value = (idx < field.size()) ? strtod(field[idx].c_str(), &end) : 0.0;
+            valid = valid && (idx < field.size()) && (end != field[idx].c_str()) && (*end == '\0') && isfinite(value);
+            return value;
+        };
+
+        if (lineNum == 1)
+            valid = (line.compare(0, 23, "MACH2K trust parameters") == 0);
+        else
+        if (field.empty() || (field[0] == "Factor"))
+            continue;
+        else
+        if (field[0] == "Tile Area km^2")
+            trust.tileArea = number(1);
+        else
+        if (field[0] == "Max Area km^2")
+            trust.maxArea = number(1);
+        else
+        if (field[0] == "Min Qual Locs")
+            trust.minQualLocs = (int)number(1);
+        else
+        if (field[0] == "Full Days")
+            trust.fullDays = number(1);
+        else
+        {
+            int f = 0;
+            while ((f < TRUST_FACTOR_CNT) && (field[0] != TRUST_FACTOR_NAMES[f]))
+                f++;
+            valid = (f < TRUST_FACTOR_CNT);
+            if (valid)
+            {
+                trust.weight[f] = number(1);
+                trust.norm[f] = number(2);
+                valid = valid && (trust.norm[f] > 0.0);
+            }
+        }
+        if (!valid)
+        {
+            cout << "Invalid trust parameters in " << modelName << " line " << lineNum << ": " << line << endl;
+            return 3;
+        }
+    }
+    return 0;
+}
+
+/**
+*
+* Add a value to a running count, mean and variance (Welford's method)
+*
+**/
+void welfordAdd(welfordStruct &acc, double value)
+{
+    acc.count += 1.0;
+    double delta = value - acc.mean;
+    acc.mean += delta/acc.count;
+    acc.m2 += delta*(value - acc.mean);
+    acc.min = min(acc.min, value);
+    acc.max = max(acc.max, value);
+}
+
+/**
+*
+* Merge another running count, mean and variance into acc, the same as adding its values
+* (Chan et al.'s pairwise update)
+*
+**/
+void welfordMerge(welfordStruct &acc, const welfordStruct &other)
+{
+    if (other.count == 0.0)
+        return;
+    double count = acc.count + other.count;
+    double delta = other.mean - acc.mean;
+    acc.mean += delta*(other.count/count);
+    acc.m2 += other.m2 + delta*delta*(acc.count*other.count/count);
+    acc.count = count;
+    acc.min = min(acc.min, other.min);
+    acc.max = max(acc.max, other.max);
+}
+
+/**
+*
+* Write the --stats report: each subject's stage times and calls, counters and peak RSS, then
+* their totals, with wallSecs the elapsed time of the whole run. JSON, or CSV (a row per subject
+* and a Total row) if statsName ends in .csv. Returns 0, or 9 if the file cannot be written.
+*
+**/
+int writeRunStats(const string &statsName, const vector<runStatsStruct> &subjects, double wallSecs)
+{
+    runStatsStruct total;
+    total.subject = "Total";
+    for (const runStatsStruct &subject : subjects)
+        addRunStats(total, subject);
+    total.wallSecs = wallSecs;
+    total.peakRssKB = peakRssKB();
+
+    ostringstream report;
+    if (filesystem::path(statsName).extension() == ".csv")
+    {
+        report << "Subject,Wall Secs";
+        for (int s = 0; s < STAGE_CNT; s++)
+            report << ',' << STAGE_NAMES[s] << " Secs," << STAGE_NAMES[s] << " Calls";
+        for (int c = 0; c < COUNT_CNT; c++)
+            report << ',' << COUNT_NAMES[c];
+        report << ",Peak RSS KB\n";
+        auto row = [&report](const runStatsStruct &stats)
+        {
+            report << stats.subject << ',' << stats.wallSecs;
+            for (int s = 0; s < STAGE_CNT; s++)
+                report << ',' << stats.stageSecs[s] << ',' << stats.stageCalls[s];
+            for (int c = 0; c < COUNT_CNT; c++)
+                report << ',' << stats.count[c];
+            report << ',' << stats.peakRssKB << '\n';
+        };
+        for (const runStatsStruct &subject : subjects)
+            row(subject);
+        row(total);
+    }
+    else
+    {
+        /** One line per subject; subject names are digits or device ids, only " and \ need escaping **/
+        auto object = [&report](const runStatsStruct &stats)
+        {
+            report << "{\"subject\": \"";
+            for (char c : stats.subject)
+                report << (((c == '"') || (c == '\\')) ? "\\" : "") << c;
+            report << "\", \"wallSecs\": " << stats.wallSecs << ", \"stages\": {";
+            for (int s = 0; s < STAGE_CNT; s++)
+                report << ((s > 0) ? ", \"" : "\"") << STAGE_NAMES[s] << "\": {\"secs\": " << stats.stageSecs[s]
+                       << ", \"calls\": " << stats.stageCalls[s] << '}';
+            report << "}, \"counts\": {";
+            for (int c = 0; c < COUNT_CNT; c++)
+                report << ((c > 0) ? ", \"" : "\"") << COUNT_NAMES[c] << "\": " << stats.count[c];
+            report << "}, \"peakRssKB\": " << stats.peakRssKB << '}';
+        };
+        report << "{\n  \"subjects\": [";
+        for (size_t i = 0; i < subjects.size(); i++)
+        {
+            report << ((i > 0) ? ",\n    " : "\n    ");
+            object(subjects[i]);
+        }
+        report << "\n  ],\n  \"total\": ";
+        object(total);
+        report << "\n}\n";
+    }
+
+    int status = writeFileAtomic(statsName, report.str(), false, cout);
+    if (status == 0)
+        cout << "Wrote " << statsName << endl;
+    return status;
+}
+
+/**
+*
+* Add one thread's or subject's --stats to a total; the peak RSS is the larger one
+*
+**/
+void addRunStats(runStatsStruct &total, const runStatsStruct &part)
+{
+    total.wallSecs += part.wallSecs;
+    for (int s = 0; s < STAGE_CNT; s++)
+    {
+        total.stageSecs[s] += part.stageSecs[s];
+        total.stageCalls[s] += part.stageCalls[s];
+    }
+    for (int c = 0; c < COUNT_CNT; c++)
+        total.count[c] += part.count[c];
+    total.peakRssKB = max(total.peakRssKB, part.peakRssKB);
+}
+
+/**
+*
+* Peak resident set size of the process so far, in KB (0 where it is not available)
+*
+**/
+long peakRssKB()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss/1024;            // bytes on macOS
+#else
+    return usage.ru_maxrss;                 // KB on Linux and the BSDs
+#endif
+#endif
+}
+
+/**
+*
+* -reduce: apply a subject's days through mergeable partial summaries instead of one day after
+* another. Each new day is read and summarized (see dayPartial()) on threadCnt threads, each
+* merging its days into its own partial summary; the threads' summaries are then merged in pairs
+* until one is left, and that is merged into the NNN_MACH2K.part left by earlier runs. Days
+* already in it are skipped, and a day earlier than the last one is merged in its date order.
+* The finished summary (see finishPartial()) is written as the state file, the same as a
+* sequential run over every day in order. Returns 0 or the program exit code.
+*
+**/
+int reduceSubject(vector<string> traceNames, const string &subject, const vector<runParamStruct> &params,
+                  const vector<string> &stateNames, unsigned threadCnt)
+{
+    if (params[0].placeRadius > 0)
+    {
+        cout << "-reduce needs tile places, --place-radius places depend on the order of the days" << endl;
+        return 1;
+    }
+    if (params[0].splitDays)
+    {
+        cout << "-reduce needs days on their own, --split-days carries stays from one day into the next" << endl;
+        return 1;
+    }
+    for (const string &traceName : traceNames)
+        if ((filesystem::path(traceName).extension() == ".m2kc") || (filesystem::path(traceName).extension() == ".m2kv"))
+        {
+            cout << "-reduce reads .plt files, not trace caches or visit logs: " << traceName << endl;
+            return 1;
+        }
+
+    /** The partial summaries so far, a state file (or legacy MACH2K.txt) without one has days that cannot be merged with **/
+    vector<mach2kPartialStruct> partials(params.size());
+    vector<string> partialNames;
+    for (size_t z = 0; z < params.size(); z++)
+    {
+        partialNames.push_back(filesystem::path(stateNames[z]).replace_extension(".part").string());
+        int status = readMach2kPartial(partialNames[z], params[z], partials[z], cout);
+        runParamStruct fileParam = params[z];
+        subjectStruct stateSubj;
+        if (status == 0)
+            status = readMach2kState(stateNames[z], fileParam, stateSubj, cout);
+        if (status != 0)
+            return status;
+        string legacyName = filesystem::path(stateNames[z]).replace_extension(".txt").string();
+        if (!stateSubj.m2kLoaded && filesystem::exists(legacyName))
+        {
+            cout << "MACH2K file " << legacyName << " has days that are not in " << partialNames[z]
+                 << ", they cannot be merged with. Move it away and run -reduce over every day instead." << endl;
+            return 6;
+        }
+        if (stateSubj.totDaysCnt != partials[z].days.size())
+        {
+            cout << "State file " << stateNames[z] << " has days that are not in " << partialNames[z]
+                 << ", they cannot be merged with. Run -reduce over every day instead." << endl;
+            return 6;
+        }
+    }
+
+    /** A day every params entry already has is skipped, the same as a date already processed **/
+    stable_sort(traceNames.begin(), traceNames.end(),
+                [](const string &a, const string &b) { return traceFileDateTime(a) < traceFileDateTime(b); });
+    vector<string> dayNames;
+    string lastDateTime;    // date/time of dayNames.back(); sorted, so a repeated date/time is the one just kept
+    for (const string &traceName : traceNames)
+    {
+        string dateTime = traceFileDateTime(traceName);
+        bool newDay = false;
+        for (const mach2kPartialStruct &partial : partials)
+            newDay = newDay || !partialHasDay(partial, dateTime);
+        newDay = newDay && (dayNames.empty() || (dateTime != lastDateTime));
+        if (newDay)
+        {
+            dayNames.push_back(traceName);
+            lastDateTime = dateTime;
+        }
+        else
+            cout << "Skipping " << traceName << ", status=6" << endl;
+    }
+    if (dayNames.empty())
+    {
+        cout << "No new days, " << stateNames[0] << " not updated." << endl;
+        return 0;
+    }
+
+    threadCnt = max(1u, min<unsigned>(threadCnt, dayNames.size()));
+    vector<workQueueStruct> workQueue(threadCnt);
+    for (size_t i = 0; i < dayNames.size(); i++)
+        workQueue[i % threadCnt].tasks.push_back(i);
+    cout << "Reducing " << dayNames.size() << " days on " << threadCnt << " threads" << endl;
+
+    /** Map: each thread summarizes days and merges them into its own partial summaries (and --stats) **/
+    auto reduceStart = chrono::steady_clock::now();
+    vector<vector<mach2kPartialStruct>> threadParts(threadCnt, vector<mach2kPartialStruct>(params.size()));
+    vector<int> dayStatus(dayNames.size(), 0);
+    vector<string> dayLogs(dayNames.size());
+    runStatsStruct *callerStats = activeStats;
+    vector<runStatsStruct> threadStats(threadCnt);
+    auto worker = [&](unsigned self)
+    {
+        size_t task;
+        vector<mach2kPartialStruct> dayParts;
+        activeStats = (callerStats != nullptr) ? &threadStats[self] : nullptr;
+        while (nextCorpusTask(workQueue, self, task))
+        {
+            ostringstream logOut;               // written in day order once every day is done
+            setLogLevel(logOut, logLevel(cout));
+            string dateTime = traceFileDateTime(dayNames[task]);
+            dayStatus[task] = mapTraceDay(dayNames[task], params, dayParts, logOut);
+            for (size_t z = 0; (z < params.size()) && (dayStatus[task] == 0); z++)
+                if (!partialHasDay(partials[z], dateTime))
+                    mergePartial(threadParts[self][z], dayParts[z]);
+            dayLogs[task] = logOut.str();
+        }
+    };
+    vector<thread> threads;
+    for (unsigned i = 0; i < threadCnt; i++)
+        threads.emplace_back(worker, i);
+    for (thread &t : threads)
+        t.join();
+    for (size_t i = 0; (callerStats != nullptr) && (i < threadStats.size()); i++)
+        addRunStats(*callerStats, threadStats[i]);
+
+    for (size_t i = 0; i < dayNames.size(); i++)
+    {
+        cout << dayLogs[i];
+        if (dayStatus[i] == 2)              // file skipped, same as a sequential run going on to the next file
+            cout << "Skipping " << dayNames[i] << ", status=2" << endl;
+        else
+        if (dayStatus[i] != 0)
+        {
+            cout << "Stopping at " << dayNames[i] << ", status=" << dayStatus[i] << ", MACH2K file not updated." << endl;
+            return dayStatus[i];
+        }
+    }
+
+    /** Reduce: the threads' partial summaries merged in pairs, in parallel, halving each round **/
+    /** (timed as one merge stage of the calling thread)                                          **/
+    stageTimer mergeTimer(STAGE_MERGE);
+    for (unsigned step = 1; step < threadCnt; step *= 2)
+    {
+        vector<thread> mergers;
+        for (unsigned i = 0; i + step < threadCnt; i += 2*step)
+            mergers.emplace_back([&, i, step]()
+            {
+                for (size_t z = 0; z < params.size(); z++)
+                    mergePartial(threadParts[i][z], threadParts[i + step][z]);
+            });
+        for (thread &t : mergers)
+            t.join();
+    }
+    double reduceSecs = chrono::duration<double>(chrono::steady_clock::now() - reduceStart).count();
+
+    for (size_t z = 0; z < params.size(); z++)
+    {
+        if (!mergePartial(partials[z], threadParts[0][z]))
+        {
+            cout << "Partial summary " << partialNames[z] << " already has a day being merged, MACH2K file not updated." << endl;
+            return 6;
+        }
+        subjectStruct subj;
+        subj.subject = subject;
+        finishPartial(partials[z], subj);
+
+        string partialBytes;
+        buildMach2kPartial(params[z], subject, partials[z], partialBytes);
+        int status = writeFileAtomic(partialNames[z], partialBytes, false, cout);
+        if (status == 0)
+            status = writeMach2kState(stateNames[z], params[z], subj, true, cout);
+        if (status != 0)
+            return status;
+        cout << "Reduced " << stateNames[z] << ": days=" << partials[z].days.size() << ", machRecCnt=" << subj.machRecCnt << endl;
+    }
+    cout << "Reduce: days=" << dayNames.size() << ", threads=" << threadCnt << ", secs=" << reduceSecs << endl;
+    return 0;
+}
+
+/**
+*
+* Read one daily trace file and summarize it at each params entry into dayParts (see
+* dayPartial()), the stays found once per zoom level (and trace interval) as mach2kEngine does.
+* Returns 0 or the processTraceFile() exit codes.
+*
+**/
+int mapTraceDay(const string &traceName, const vector<runParamStruct> &params, vector<mach2kPartialStruct> &dayParts,
+                ostream &logOut)
+{
+    traceFileStruct traceFile;
+    vector<traceStruct> traceRecs;
+
+    if (!openTraceFile(traceName, traceFile))
+    {
+        logAt(LOG_ERROR, logOut) << "Cannot open input file" << traceName << endl;
+        return 2;
+    }
+    logAt(LOG_INFO, logOut) << "input name=" << traceName << endl;
+    int status = readTraceDay(traceFile, traceName, traceRecs, logOut);
+    if (status != 0)
+        return status;
+
+    string fileNameDateTime = traceFileDateTime(traceName);
+    dayParts.assign(params.size(), mach2kPartialStruct());
+    vector<int> xTiles(traceRecs.size()), yTiles(traceRecs.size());
+    vector<bool> summarized(params.size(), false);
+    dayStaysStruct day;
+    for (size_t g = 0; g < params.size(); g++)
+    {
+        if (summarized[g])
+            continue;
+        projectTiles(traceRecs.data(), traceRecs.size(), params[g].numTiles, xTiles.data(), yTiles.data());
+        findStays(traceRecs.data(), xTiles.data(), yTiles.data(), traceRecs.size(), params[g].requiredTraceInterval, 0.0,
+                  day, logOut);
+        for (size_t p = g; p < params.size(); p++)
+            if (!summarized[p] && (params[p].zoomLevel == params[g].zoomLevel) &&
+                (params[p].requiredTraceInterval == params[g].requiredTraceInterval))
+            {
+                dayPartial(day, fileNameDateTime, params[p], dayParts[p]);
+                summarized[p] = true;
+            }
+    }
+    return 0;
+}
+
+/**
+*
+* Summarize one day's stays at param.timeInPlace into an empty partial summary: the same
+* location records applyStays() would add or update, with exact totals so summaries add in any
+* order, and the day's additions to the subject totals, kept apart to be applied in date order.
+*
+**/
+void dayPartial(const dayStaysStruct &day, const string &fileNameDateTime, const runParamStruct &param,
+                mach2kPartialStruct &partial)
+{
+    stageTimer timer(STAGE_APPLY);
+    partialDayStruct dayRec;
+    memset(&dayRec, 0, sizeof(dayRec));     // no stray bytes in the partial summary file
+    snprintf(dayRec.fileNameDateTime, sizeof(dayRec.fileNameDateTime), "%s", fileNameDateTime.c_str());
+    snprintf(dayRec.maxTraceIntervalHHMMSS, sizeof(dayRec.maxTraceIntervalHHMMSS), "%s", day.maxTraceIntervalHHMMSS.c_str());
+    dayRec.totHrs = day.totHrs;
+    dayRec.totTraceInterval = day.totTraceInterval;
+    dayRec.maxTraceInterval = day.maxTraceInterval;
+    dayRec.minTraceInterval = day.minTraceInterval;
+    dayRec.traceRecCnt = day.traceRecCnt;
+    dayRec.locCnt = day.locChanges;
+    dayRec.firstQualStay = partial.qualHours.size();
+
+    /** Records first made this day sort after earlier days' and in stay order within it **/
+    uint64_t dayKey = strtoull(fileNameDateTime.c_str(), nullptr, 10) << 16;
+    uint64_t stayOrdinal = 0;
+    for (const stayStruct &stay : day.stays)
+    {
+        if (!stay.closed)
+        {
+            if (!day.singleRec && (stay.duraTime < param.timeInPlace))
+                continue;
+            dayRec.locCnt += 1;
+            dayRec.qualDay = 1;
+        }
+        if (stay.duraTime < param.timeInPlace)
+            continue;
+        dayRec.qualDay = 1;
+
+        partial.minXtile = min(partial.minXtile, stay.xTile);
+        partial.minYtile = min(partial.minYtile, stay.yTile);
+        partial.maxXtile = max(partial.maxXtile, stay.xTile);
+        partial.maxYtile = max(partial.maxYtile, stay.yTile);
+        partial.qualHours.push_back(stay.duraTime * 24.0);
+        dayRec.qualStayCnt += 1;
+        countStat(COUNT_QUAL_STAYS, 1);
+        int qualTraceCnt = stay.traceCnt + 1;
+        dayRec.qualTraceCnt += qualTraceCnt;
+
+        uint64_t key = tileKey(stay.xTile, stay.yTile);
+        int placeIdx = findTileRec(partial.placeIndex, key);
+        if (placeIdx == -1)
+        {
+            placeIdx = partial.places.size();
+            partial.places.emplace_back();
+            partialPlaceStruct &place = partial.places.back();
+            place.rec.xTile = stay.xTile;
+            place.rec.yTile = stay.yTile;
+            place.rec.hour = 99;            // set from hist by finishPartial()
+            place.rec.dow = 9;
+            place.rec.firstYYYYMMDD = stay.YYYYMMDD;
+            place.orderKey = dayKey + min<uint64_t>(stayOrdinal, 0xFFFF);
+            insertTileRec(partial.placeIndex, key, placeIdx);
+        }
+        partialPlaceStruct &place = partial.places[placeIdx];
+        place.rec.freq += 1;
+        place.duraMicroHours += microHours(stay.duraTime * 24.0);
+        place.rec.traceCnt += qualTraceCnt;
+        place.rec.lastYYYYMMDD = stay.YYYYMMDD;
+        place.lastKey = dayKey + min<uint64_t>(stayOrdinal, 0xFFFF);
+        addDwellHist(place.hist, place.rec, day.spans.data() + stay.spanIdx, stay.spanCnt);
+        stayOrdinal += 1;
+    }
+    partial.days.push_back(dayRec);
+}
+
+/**
+*
+* Merge partial summary other into partial. Location records add up exactly (durations in
+* whole microhours, see microHours()) and the days are kept in date order, so merges in any
+* order and grouping finish to the same subject. Returns false, with partial unchanged, if
+* other has a day partial already has.
+*
+**/
+bool mergePartial(mach2kPartialStruct &partial, const mach2kPartialStruct &other)
+{
+    stageTimer timer(STAGE_MERGE);
+    vector<partialDayStruct> days;
+    vector<double> qualHours;
+    days.reserve(partial.days.size() + other.days.size());
+    qualHours.reserve(partial.qualHours.size() + other.qualHours.size());
+    for (size_t i = 0, j = 0; (i < partial.days.size()) || (j < other.days.size()); )
+    {
+        int order = (i == partial.days.size()) ? 1 : (j == other.days.size()) ? -1 :
+                    strcmp(partial.days[i].fileNameDateTime, other.days[j].fileNameDateTime);
+        if (order == 0)
+            return false;
+        const mach2kPartialStruct &from = (order < 0) ? partial : other;
+        const partialDayStruct &day = (order < 0) ? partial.days[i++] : other.days[j++];
+        days.push_back(day);
+        days.back().firstQualStay = qualHours.size();
+        qualHours.insert(qualHours.end(), from.qualHours.begin() + day.firstQualStay,
+                         from.qualHours.begin() + day.firstQualStay + day.qualStayCnt);
+    }
+    partial.days.swap(days);
+    partial.qualHours.swap(qualHours);
+
+    for (const partialPlaceStruct &otherPlace : other.places)
+    {
+        uint64_t key = tileKey(otherPlace.rec.xTile, otherPlace.rec.yTile);
+        int placeIdx = findTileRec(partial.placeIndex, key);
+        if (placeIdx == -1)
+        {
+            insertTileRec(partial.placeIndex, key, partial.places.size());
+            partial.places.push_back(otherPlace);
+            continue;
+        }
+        partialPlaceStruct &place = partial.places[placeIdx];
+        place.rec.freq += otherPlace.rec.freq;
+        place.rec.traceCnt += otherPlace.rec.traceCnt;
+        place.duraMicroHours += otherPlace.duraMicroHours;
+        if (otherPlace.orderKey < place.orderKey)
+        {
+            place.orderKey = otherPlace.orderKey;
+            place.rec.firstYYYYMMDD = otherPlace.rec.firstYYYYMMDD;
+        }
+        if (otherPlace.lastKey > place.lastKey)
+        {
+            place.lastKey = otherPlace.lastKey;
+            place.rec.lastYYYYMMDD = otherPlace.rec.lastYYYYMMDD;
+        }
+        for (int d = 0; d < 7; d++)
+            for (int h = 0; h < 24; h++)
+                place.hist.secs[d][h] += otherPlace.hist.secs[d][h];
+    }
+    partial.minXtile = min(partial.minXtile, other.minXtile);
+    partial.minYtile = min(partial.minYtile, other.minYtile);
+    partial.maxXtile = max(partial.maxXtile, other.maxXtile);
+    partial.maxYtile = max(partial.maxYtile, other.maxYtile);
+    return true;
+}
+
+/**
+*
+* Set the subject's MACH2K totals and records (all but its name) from a partial summary: the
+* records in the order a sequential run makes them, and the days' totals added in date order
+* with the same rounding between days (see roundTripTotals()), so the state file is the same.
+*
+**/
+void finishPartial(const mach2kPartialStruct &partial, subjectStruct &subj)
+{
+    stageTimer timer(STAGE_MERGE);
+    string subject = subj.subject;
+    subj = subjectStruct();
+    subj.subject = subject;
+
+    vector<size_t> order(partial.places.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(),
+         [&partial](size_t a, size_t b) { return partial.places[a].orderKey < partial.places[b].orderKey; });
+    for (size_t i : order)
+    {
+        const partialPlaceStruct &place = partial.places[i];
+        subj.mach2kRec.push_back(place.rec);
+        subj.dwellHist.push_back(place.hist);
+        subj.mach2kRec.back().dura = place.duraMicroHours/1e6;     // the same double as roundDuraHours()
+        addDwellHist(subj.dwellHist.back(), subj.mach2kRec.back(), nullptr, 0);
+    }
+    subj.machRecCnt = subj.mach2kRec.size();
+    rebuildTileIndex(subj);
+    subj.minXtile = partial.minXtile;
+    subj.minYtile = partial.minYtile;
+    subj.maxXtile = partial.maxXtile;
+    subj.maxYtile = partial.maxYtile;
+
+    /** The same additions, in the same order, as applyStays() **/
+    for (const partialDayStruct &day : partial.days)
+    {
+        if (subj.m2kLoaded)
+            roundTripTotals(subj);
+        subj.traceRecCnt += day.traceRecCnt;
+        subj.totTraceInterval += day.totTraceInterval;
+        subj.totHrsCnt += day.totHrs;
+        if (day.maxTraceInterval > subj.maxTraceInterval)
+        {
+            subj.maxTraceInterval = day.maxTraceInterval;
+            subj.maxTraceIntervalHHMMSS = day.maxTraceIntervalHHMMSS;
+        }
+        if (day.minTraceInterval < subj.minTraceInterval)
+            subj.minTraceInterval = day.minTraceInterval;
+        subj.totLocsCnt += day.locCnt;
+        for (uint32_t q = 0; q < day.qualStayCnt; q++)
+            subj.totQualDura += partial.qualHours[day.firstQualStay + q];
+        subj.totQualTraceCnt += day.qualTraceCnt;
+        if (day.qualDay)
+            ++subj.totQualDaysCnt;
+        if (!subj.m2kLoaded)
+            subj.firstDateTime = day.fileNameDateTime;
+        subj.lastDateTime = day.fileNameDateTime;
+        ++subj.totDaysCnt;
+        subj.m2kLoaded = true;
+    }
+}
+
+/**
+*
+* True if the partial summary has the day named by this YYYYMMDDHHMMSS date/time
+*
+**/
+bool partialHasDay(const mach2kPartialStruct &partial, const string &fileNameDateTime)
+{
+    auto day = lower_bound(partial.days.begin(), partial.days.end(), fileNameDateTime,
+                           [](const partialDayStruct &d, const string &dateTime) { return d.fileNameDateTime < dateTime; });
+    return (day != partial.days.end()) && (fileNameDateTime == day->fileNameDateTime);
+}
+
+/**
+*
+* Hours rounded to the 6 decimals of roundDuraHours(), as a whole number of microhours
+*
+**/
+int64_t microHours(double hours)
+{
+    char hoursStr[64];
+    to_chars_result result = to_chars(hoursStr, hoursStr + sizeof(hoursStr), hours, chars_format::fixed, 6);
+    int64_t micro = 0;
+    for (const char *c = hoursStr; c < result.ptr; c++)
+        if (isdigit((unsigned char)*c))
+            micro = micro*10 + (*c - '0');
+    return (hoursStr[0] == '-') ? -micro : micro;
+}
+
+/**
+*
+* The binary NNN_MACH2K.part contents of a partial summary: a mach2kPartialHeaderStruct, then
+* the days, their qualifying stay hours and the location records
+*
+**/
+void buildMach2kPartial(const runParamStruct &param, const string &subject, const mach2kPartialStruct &partial,
+                        string &partialBytes)
+{
+    mach2kPartialHeaderStruct header;
+    memset(&header, 0, sizeof(header));
+
+    memcpy(header.magic, M2K_PARTIAL_MAGIC, sizeof(header.magic));
+    header.version = M2K_PARTIAL_VERSION;
+    snprintf(header.zoomLevelStr, sizeof(header.zoomLevelStr), "%s", param.zoomLevelStr.c_str());
+    snprintf(header.durationStr, sizeof(header.durationStr), "%s", param.durationStr.c_str());
+    snprintf(header.subject, sizeof(header.subject), "%s", subject.c_str());
+    header.minXtile = partial.minXtile;
+    header.minYtile = partial.minYtile;
+    header.maxXtile = partial.maxXtile;
+    header.maxYtile = partial.maxYtile;
+    header.dayCnt = partial.days.size();
+    header.qualStayCnt = partial.qualHours.size();
+    header.placeCnt = partial.places.size();
+
+    partialBytes.assign((const char *)&header, sizeof(header));
+    partialBytes.append((const char *)partial.days.data(), partial.days.size() * sizeof(partialDayStruct));
+    partialBytes.append((const char *)partial.qualHours.data(), partial.qualHours.size() * sizeof(double));
+    partialBytes.append((const char *)partial.places.data(), partial.places.size() * sizeof(partialPlaceStruct));
+    header.checksum = partialChecksum(partialBytes);
+    memcpy(&partialBytes[0], &header, sizeof(header));
+}
+
+/**
+*
+* FNV-1a hash of a partial summary file's contents, taken with the header checksum = 0
+*
+**/
+uint64_t partialChecksum(const string &partialBytes)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < partialBytes.size(); i++)
+    {
+        bool inChecksum = (i >= offsetof(mach2kPartialHeaderStruct, checksum)) &&
+                          (i < offsetof(mach2kPartialHeaderStruct, checksum) + sizeof(uint64_t));
+        hash ^= inChecksum ? 0 : (unsigned char)partialBytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/**
+*
+* Load a NNN_MACH2K.part partial summary. A missing file is not an error and leaves partial
+* empty. Returns 0, 3 if it is not a valid partial summary, 4 or 5 if its zoom level or secs.
+* in place are not param's, or 8 if its size does not match its counts.
+*
+**/
+int readMach2kPartial(const string &partialName, const runParamStruct &param, mach2kPartialStruct &partial, ostream &logOut)
+{
+    traceFileStruct partialFile;
+    mach2kPartialHeaderStruct header;
+
+    partial = mach2kPartialStruct();
+    if (!mapFile(partialName, partialFile))     // no days yet
+        return 0;
+    if ((partialFile.size < sizeof(header)) || (memcmp(partialFile.data, M2K_PARTIAL_MAGIC, sizeof(header.magic)) != 0))
+    {
+        logAt(LOG_ERROR, logOut) << "Invalid MACH2K partial summary " << partialName << ", no header." << endl;
+        return 3;
+    }
+    memcpy(&header, partialFile.data, sizeof(header));
+    if (header.version != M2K_PARTIAL_VERSION)
+    {
+        logAt(LOG_ERROR, logOut) << "MACH2K partial summary " << partialName << " is version " << header.version
+               << ", this program reads version " << M2K_PARTIAL_VERSION << ". Rebuild it from the trace files." << endl;
+        return 3;
+    }
+    if (partialFile.size != sizeof(header) + header.dayCnt * sizeof(partialDayStruct) +
+                            header.qualStayCnt * sizeof(double) + header.placeCnt * sizeof(partialPlaceStruct))
+    {
+        logAt(LOG_ERROR, logOut) << "Mach record count error" << endl;
+        return 8;
+    }
+    string partialBytes(partialFile.data, partialFile.size);
+    if (partialChecksum(partialBytes) != header.checksum)
+    {
+        logAt(LOG_ERROR, logOut) << "MACH2K partial summary " << partialName << " checksum error." << endl;
+        return 3;
+    }
+    if (param.zoomLevelStr != header.zoomLevelStr)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K partial summary zoom level of " << header.zoomLevelStr
+             << " must equal input zoom level of " << param.zoomLevelStr << "." << endl;
+        return 4;
+    }
+    if (param.durationStr != header.durationStr)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K partial summary time duration of " << header.durationStr
+             << " must equal input time duration of " << param.durationStr << " seconds." << endl;
+        return 5;
+    }
+
+    const char *next = partialFile.data + sizeof(header);
+    const partialDayStruct *fileDay = (const partialDayStruct *)next;
+    partial.days.assign(fileDay, fileDay + header.dayCnt);
+    next += header.dayCnt * sizeof(partialDayStruct);
+    const double *fileHours = (const double *)next;
+    partial.qualHours.assign(fileHours, fileHours + header.qualStayCnt);
+    next += header.qualStayCnt * sizeof(double);
+    const partialPlaceStruct *filePlace = (const partialPlaceStruct *)next;
+    partial.places.assign(filePlace, filePlace + header.placeCnt);
+    partial.minXtile = header.minXtile;
+    partial.minYtile = header.minYtile;
+    partial.maxXtile = header.maxXtile;
+    partial.maxYtile = header.maxYtile;
+    for (size_t i = 0; i < partial.places.size(); i++)
+        insertTileRec(partial.placeIndex, tileKey(partial.places[i].rec.xTile, partial.places[i].rec.yTile), i);
+    return 0;
+}
+
+/**
+*
+* Get the next corpus subject for worker self: the front of its own queue, else
+* steal from the back of another worker's queue. False when all queues are empty.
+*
+**/
+bool nextCorpusTask(vector<workQueueStruct> &workQueue, unsigned self, size_t &task)
+{
+    for (size_t i = 0; i < workQueue.size(); i++)
+    {
+        workQueueStruct &queue = workQueue[(self + i) % workQueue.size()];
+        lock_guard<mutex> guard(queue.lock);
+        if (!queue.tasks.empty())
+        {
+            if (i == 0)
+            {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+*
+* List the .plt trace files in a directory
+*
+**/
+vector<string> listTraceFiles(const string &dirName)
+{
+    vector<string> traceNames;
+    error_code ec;
+
+    for (const auto &entry : filesystem::directory_iterator(dirName, ec))
+        if (entry.is_regular_file(ec) && entry.path().extension() == ".plt")
+            traceNames.push_back(entry.path().string());
+    return traceNames;
+}
+
+/**
+*
+* Read an existing MACH2K.txt file into the subject totals and records. A missing file is
+* not an error; the subject starts with zero totals. Returns 0 or the program exit code.
+*
+**/
+int readMach2kFile(const string &m2kName, const runParamStruct &param, subjectStruct &subj, ostream &logOut)
+{
+    stageTimer timer(STAGE_STATE_READ);
+    ifstream inFileM2K;                 //first test if MACH2K.txt already exists to read records
+    string junkRec;
+    string totDaysCntStr, totHrsCntStr, totLocsCntStr, qualLocsCntStr, totQualDuraStr, totQualDaysCntStr;
+    string minXtileStr, minYtileStr, maxXtileStr, maxYtileStr;
+    string fileZoomLevel, fileDuration;
+    string maxTraceIntervalStr;        // String to read from MACH2K file header record
+    string minTraceIntervalStr;
+    string totQualTraceCntStr;
+    string totTraceIntervalStr;
+    string traceRecCntStr;
+    double qualLocsCnt = 0.0;
+    vector<mach2kStruct> &mach2kRec = subj.mach2kRec;
+    int &machRecCnt = subj.machRecCnt;
+
+    inFileM2K.open(m2kName);  // open MACH2K as an ifstream file for reading first, to see if it exists
+
+    /** Future enhancement here: MACH2k.txt can have "seeded" records to determine trust                             **/
+    /** first date = date of first match when frequency value is currently zero or negative? to indicate seed value  **/
+    if (!inFileM2K) // skip reading if no existing MACH2K.txt file
+        return 0;
+
+    getline(inFileM2K, junkRec); // Get first record with column headings
+    if (junkRec.substr(0,5) != "xTile")
+    {
+        logAt(LOG_ERROR, logOut) << "First 5 bytes of MACH2K header rec#1=" << junkRec.substr(0,5) << endl;
+        logAt(LOG_ERROR, logOut) << "Invalid MACH2K header record. First record must begin with 'xTile'." << endl;
+        return 3;
+    }
+
+    /** Get 2nd record distance and duration parameters **/
+    getline(inFileM2K, junkRec, '=');
+    getline(inFileM2K, fileZoomLevel, ',');  // Need to change to zoom level of 21
+    getline(inFileM2K, junkRec, '=');
+    getline(inFileM2K, fileDuration, ',');
+    getline(inFileM2K, junkRec);          // read remaining record to set up to read next record
+
+    logAt(LOG_DEBUG, logOut) << "File distance=" << fileZoomLevel << ", Zoom level parameter=" << param.zoomLevelStr << endl;
+    logAt(LOG_DEBUG, logOut) << "File duration=" << fileDuration << ", Duration parameter=" << param.durationStr << endl;
+    if (fileZoomLevel != param.zoomLevelStr)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K file zoom level of "
+             << fileZoomLevel << " must equal input distance limit of " << param.zoomLevelStr << "." << endl;
+        return 4;
+    }
+    if (fileDuration != param.durationStr)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K file time duration of "
+             << fileDuration << "must equal input time duration of " << param.durationStr << " seconds." << endl;
+        return 5;
+    }
+    getline(inFileM2K, junkRec);      // Skip third record, just headings for summary data
+    getline(inFileM2K, subj.firstDateTime, ','); // Get fourth record with totals (convert to integers for accumulating)
+    getline(inFileM2K, subj.lastDateTime, ',');
+    getline(inFileM2K, totDaysCntStr, ',');
+    getline(inFileM2K, totHrsCntStr, ',');
+    getline(inFileM2K, totLocsCntStr, ',');
+    getline(inFileM2K, qualLocsCntStr,',');
+    getline(inFileM2K, totQualDuraStr,',');
+    getline(inFileM2K, totQualDaysCntStr, ',');
+    getline(inFileM2K, junkRec, ',');  // skip percentage field, will calculate at end
+    getline(inFileM2K, minXtileStr,',');
+    getline(inFileM2K, minYtileStr,',');
+    getline(inFileM2K, maxXtileStr,',');
+    getline(inFileM2K, maxYtileStr, ',');
+    getline(inFileM2K, junkRec,',');    // skip #1 loc%, calculate at end
+    getline(inFileM2K, junkRec,',');    // skip #2 loc%, calculate at end
+    getline(inFileM2K, junkRec,',');    // skip #3 loc%, calculate at end
+    getline(inFileM2K, junkRec,',');    // skip #4 loc%, calculate at end
+    getline(inFileM2K, junkRec,',');    // skip #5 loc%, calculate at end
+    getline(inFileM2K, junkRec,',');    // skip #6 loc%, calculate at end
+    getline(inFileM2K, junkRec, ',');   // skip subject, Filename check covers that
+    getline(inFileM2K, junkRec,',');    // skip next 9 fields: QH/Qdays to TRUST
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, junkRec,',');
+    getline(inFileM2K, traceRecCntStr,',');
+    getline(inFileM2K, maxTraceIntervalStr,',');
+    getline(inFileM2K, subj.maxTraceIntervalHHMMSS,',');
+    getline(inFileM2K, minTraceIntervalStr,',');
+    getline(inFileM2K, totTraceIntervalStr,',');
+    getline(inFileM2K, junkRec,',');           // ignore average trace interval, will recalculate
+    getline(inFileM2K, junkRec,',');           // ignore traces per day, will recalculate
+    getline(inFileM2K, totQualTraceCntStr);
+
+    subj.totDaysCnt = stof(totDaysCntStr);
+    subj.totHrsCnt = stof(totHrsCntStr);
+    subj.totLocsCnt = stof(totLocsCntStr);
+    qualLocsCnt = stof(qualLocsCntStr);     //Number of locations qualifying for minimum duration time
+    subj.totQualDura = stof(totQualDuraStr);     //Number of hours qualifying for minimum duration time
+    subj.totQualDaysCnt = stof(totQualDaysCntStr); //Number of days with at least one qualifying location/duration
+    subj.minXtile = stoi(minXtileStr);
+    subj.minYtile = stoi(minYtileStr);
+    subj.maxXtile = stoi(maxXtileStr);
+    subj.maxYtile = stoi(maxYtileStr);
+    subj.traceRecCnt = stoi(traceRecCntStr);
+    subj.maxTraceInterval = stof(maxTraceIntervalStr)/(24.0*60.0*60.0); // convert seconds to days
+    subj.minTraceInterval = stof(minTraceIntervalStr);                   // don't convert to days, too small
+    subj.totTraceInterval = stof(totTraceIntervalStr)/(24.0*60.0*60.0); // total elapsed time of all traces
+    subj.totQualTraceCnt = stoi(totQualTraceCntStr);
+
+    logAt(LOG_DEBUG, logOut) << "Reading: traceRecCnt=" << subj.traceRecCnt
+         << ",maxTraceInterval=" << subj.maxTraceInterval*24.0*60.0*60.0
+         << "minTraceInterval=" << subj.minTraceInterval
+         << ",totTraceInterval="<< subj.totTraceInterval*24.0*60.0*60.0
+         << ",Traces per day=" << (subj.traceRecCnt/subj.totDaysCnt)
+         << ",Avg. Trace=" << (subj.totTraceInterval*24.0*60.0*60.0)/((subj.traceRecCnt*1.0)-subj.totDaysCnt) << endl;
+    logAt(LOG_DEBUG, logOut) << "M2K read: minXtile=" << subj.minXtile << ",minYtile=" << subj.minYtile << ",maxXtile=" << subj.maxXtile
+         << ",maxYtile=" << subj.maxYtile << endl;
+
+    if (qualLocsCnt > 0)
+    {
+    string recField[9];                 // xTile,yTile,Hour,DOW,Freq,Hours Duration,Trace Cnt,FirstDate,LastDate
+    mach2kStruct machRec;
+    mach2kRec.reserve((size_t)qualLocsCnt);
+    while (getline(inFileM2K, recField[0], ',') &&
+                getline(inFileM2K, recField[1], ',') &&
+                getline(inFileM2K, recField[2], ',') &&
+                getline(inFileM2K, recField[3], ',') &&
+                getline(inFileM2K, recField[4], ',') &&
+                getline(inFileM2K, recField[5], ',') &&
+                getline(inFileM2K, recField[6], ',') &&
+                getline(inFileM2K, recField[7], ',') &&
+                getline(inFileM2K, recField[8]) &&
+                parseMach2kRec(recField, machRec))   // a malformed record ends up as a count error
+        {
+                mach2kRec.push_back(machRec);
+                machRecCnt += 1;
+        } // while not eof
+    } // if (qualLocsCnt > 0)
+
+    if (machRecCnt != qualLocsCnt)
+    {
+        logAt(LOG_ERROR, logOut) << "Mach record count error" << endl;
+        return 8;
+    }
+    subj.dwellHist.assign(machRecCnt, dwellHistStruct());   // MACH2K.txt has no hour of week histograms
+    rebuildTileIndex(subj);
+    if (param.placeRadius > 0)
+    {
+        /** MACH2K.txt has only the tiles, each becomes a place at the tile center **/
+        subj.places.centers.resize(machRecCnt);
+        for (int i = 0; i < machRecCnt; i++)
+            tileCenter(mach2kRec[i].xTile, mach2kRec[i].yTile, param.numTiles,
+                       subj.places.centers[i].latitude, subj.places.centers[i].longitude);
+        rebuildPlaceIndex(subj.places, param.placeRadius/1000.0);
+    }
+    inFileM2K.close();
+
+    subj.m2kLoaded = true;
+    return 0;
+}
+
+/**
+*
+* Process one daily GPS trace file into the engine's MACH2K totals and records at each of
+* its params entries (see mach2kEngine::ingestDay()). Returns 0, or the program exit code if
+* the file was not applied.
+*
+**/
+int processTraceFile(const string &traceName, mach2kEngine &engine, ostream &logOut)
+{
+    traceFileStruct traceFile;          //GPS trace file input
+    vector<traceStruct> traceRecs;   // the day's trace records
+
+    if (!openTraceFile(traceName, traceFile))   // Open a GPS trace file, skips the six header records
+    {
+        logAt(LOG_ERROR, logOut) << "Cannot open input file" << traceName << endl;
+        return 2;
+    }
+
+    logAt(LOG_INFO, logOut) << "input name=" << traceName << endl;
+
+    /** Save fileNameDateTime in case existing MACH2k.txt file has a different firstDateTime **/
+    string fileNameDateTime = traceFileDateTime(traceName);
+    logAt(LOG_DEBUG, logOut) << "fileNameDateTime=" << fileNameDateTime << endl;
+
+    /** If current input file date is same or earlier than the last date in MACH2K file, exit, don't double count **/
+    /** (a zoom level added later can still take a date the others already have)                                  **/
+    if (!engine.takesDay(fileNameDateTime))
+    {
+        logAt(LOG_ERROR, logOut) << "Trace file cannot be earlier or the same date as the latest processed file date." << endl;
+        return 6;
+    }
+
+    /** Read the day's trace records, the engine projects them all to tiles in one batch **/
+    int status = readTraceDay(traceFile, traceName, traceRecs, logOut);
+    if (status != 0)
+        return status;
+
+    return engine.ingestDay(traceRecs.data(), traceRecs.size(), fileNameDateTime);
+}
+
+/**
+*
+* Process a GPS trace file of any number of days a record at a time (--split-days, see
+* mach2kEngine::ingest()): each date is a day named by its first record, the open day goes on
+* into the next file, and a record before the one already read, or of a day already processed,
+* is skipped. Returns 0, 2 if the file cannot be opened, 6 if every record was skipped or 10
+* if it has no trace records.
+*
+**/
+int processTraceStream(const string &traceName, mach2kEngine &engine, ostream &logOut)
+{
+    traceFileStruct traceFile;          //GPS trace file input
+    traceStruct traceRec;
+
+    if (!openTraceFile(traceName, traceFile))   // Open a GPS trace file, skips the six header records
+    {
+        logAt(LOG_ERROR, logOut) << "Cannot open input file" << traceName << endl;
+        return 2;
+    }
+
+    logAt(LOG_INFO, logOut) << "input name=" << traceName << endl;
+
+    /** Only the open day is kept, and the pages already read are dropped, so a long file takes no more memory **/
+    stageTimer timer(STAGE_PARSE);
+    size_t traceRecCnt = 0, skippedCnt = 0;
+    const char *dropped = traceFile.data;
+    while (readTraceRec(traceFile, traceRec))
+    {
+        traceRecCnt += 1;
+        stageTimer staysTimer(STAGE_STAYS);
+        if (engine.ingest(traceRec) != 0)
+            skippedCnt += 1;
+#ifndef _WIN32
+        if (traceFile.mapped && ((size_t)(traceFile.next - dropped) >= SPLIT_DROP_BYTES))
+        {
+            const char *readTo = dropped + ((size_t)(traceFile.next - dropped) & ~(SPLIT_DROP_BYTES - 1));
+            madvise((void *)dropped, readTo - dropped, MADV_DONTNEED);
+            dropped = readTo;
+        }
+#endif
+    }
+    countStat(COUNT_TRACE_FILES, 1);
+    countStat(COUNT_TRACE_RECS, traceRecCnt);
+    countStat(COUNT_BAD_RECS, traceFile.badRecCnt);
+
+    if (traceFile.badRecCnt > 0)
+    {
+        logAt(LOG_INFO, logOut) << "Skipped " << traceFile.badRecCnt << " malformed trace records in " << traceName
+             << ", first at line " << traceFile.firstBadLineNum << endl;
+    }
+    closeTraceFile(traceFile);
+
+    if (traceRecCnt == 0)
+    {
+        logAt(LOG_ERROR, logOut) << "Input " << traceName << " has no trace records." << endl;
+        return 10;
+    }
+    if (skippedCnt > 0)
+    {
+        logAt(LOG_INFO, logOut) << "Skipped " << skippedCnt << " trace records in " << traceName
+             << " out of order or of a date already processed" << endl;
+    }
+    return (skippedCnt == traceRecCnt) ? 6 : 0;
+}
+
+/**
+*
+* Read an open daily trace file's records, up to the first record of another date, and close
+* it. Returns 0, or 10 if it has no trace records.
+*
+**/
+int readTraceDay(traceFileStruct &traceFile, const string &traceName, vector<traceStruct> &traceRecs, ostream &logOut)
+{
+    stageTimer timer(STAGE_PARSE);
+    traceStruct  traceRec;
+
+    traceRecs.clear();
+    while (readTraceRec(traceFile, traceRec))
+    {
+        /**   Check for day changing, if so, stop processing this file, should only include one day **/
+        if (!traceRecs.empty() && (traceRec.YYYYMMDD != traceRecs[0].YYYYMMDD))
+        {
+            logAt(LOG_INFO, logOut) << "New day, break!" << endl;
+            break;
+        }
+        traceRecs.push_back(traceRec);
+    }
+    countStat(COUNT_TRACE_FILES, 1);
+    countStat(COUNT_TRACE_RECS, traceRecs.size());
+    countStat(COUNT_BAD_RECS, traceFile.badRecCnt);
+
+    if (traceRecs.empty())
+    {
+        logAt(LOG_ERROR, logOut) << "Input " << traceName << " has no trace records." << endl;
+        return 10;
+    }
+
+    if (traceFile.badRecCnt > 0)
+    {
+        logAt(LOG_INFO, logOut) << "Skipped " << traceFile.badRecCnt << " malformed trace records in " << traceName
+             << ", first at line " << traceFile.firstBadLineNum << endl;
+    }
 
     /** Close daily GPS trace file **/
-    inFile.close();
+    closeTraceFile(traceFile);
+    return 0;
+}
+
+/**
+*
+* Find one day's stays, already projected to tiles: each run of trace records in the same tile
+* (with placeRadius km, within it of the run's first record), with the time counted toward
+* timeInPlace (trace intervals up to requiredTraceInterval) and the traces counted for the
+* location, plus the day's trace interval totals. None of it depends on timeInPlace, so one
+* findStays() serves every secs. in place of a run. With tile places the records are collapsed
+* into runs first (see compactRuns()), one per stay.
+*
+**/
+void findStays(const traceStruct traceRecs[], const int xTiles[], const int yTiles[], size_t traceCnt,
+               int requiredTraceInterval, double placeRadius, dayStaysStruct &day, ostream &logOut)
+{
+    stageTimer timer(STAGE_STAYS);
+    if (placeRadius <= 0.0)
+    {
+        compactRuns(traceRecs, xTiles, yTiles, traceCnt, requiredTraceInterval, day);
+        runStays(day);
+        countStat(COUNT_STAYS, day.stays.size());
+        logAt(LOG_DEBUG, logOut) << "runs=" << day.runs.size() << ", traces=" << traceCnt << ", EOF: duraTime="
+                                 << day.stays.back().duraTime << endl;
+        return;
+    }
+
+    beginStays(traceRecs[0], xTiles[0], yTiles[0], day);
+    logAt(LOG_DEBUG, logOut) << "1) xTileSave=" << xTiles[0] << ", yTileSave=" << yTiles[0] << endl;
+
+    for (size_t traceIdx = 1; traceIdx < traceCnt; traceIdx++)
+        addStayRec(traceRecs[traceIdx - 1], traceRecs[traceIdx], xTiles[traceIdx], yTiles[traceIdx],
+                   requiredTraceInterval, placeRadius, day, logOut);
+
+    endStays(traceRecs[traceCnt - 1], day);
+    countStat(COUNT_STAYS, day.stays.size());
+    logAt(LOG_DEBUG, logOut) << "stays=" << day.stays.size() << ", EOF: duraTime=" << day.stays.back().duraTime << endl;
+}
+
+/**
+*
+* Collapse one day's trace records, projected to tiles, into runs of consecutive records in the
+* same tile, with the day's trace interval totals and the spans of each run's duraTime. The sums
+* are taken record by record in the same order as addStayRec(), so the runs' stays are the same
+* to the bit, but the totals are kept in locals and a record only tests its own tile.
+*
+**/
+void compactRuns(const traceStruct traceRecs[], const int xTiles[], const int yTiles[], size_t traceCnt,
+                 int requiredTraceInterval, dayStaysStruct &day)
+{
+    vector<traceRunStruct> &runs = day.runs;
+    vector<pair<double, double>> &spans = day.spans;
+    double totHrs = 0.0, totTraceInterval = 0.0, maxTraceInterval = 0.0, minTraceInterval = HUGE_VAL;
+    size_t maxIntervalIdx = 0;
+    int    traceRecCnt = 1;             // the first record
+    size_t spanIdx = 0;                 // the open run's first span
+
+    runs.clear();
+    spans.clear();
+    traceRunStruct run = {};
+    run.xTile = xTiles[0];
+    run.yTile = yTiles[0];
+    run.startTime = traceRecs[0].dayNum;
+    run.pointCnt = 1;
+    run.traceCnt = 1;                   // the first record counts for the first run
+    for (size_t i = 1; i < traceCnt; i++)
+    {
+        double saveTime = traceRecs[i - 1].dayNum;
+        double currTime = traceRecs[i].dayNum;
+        double interval = currTime - saveTime;
+        bool   sameTile = (xTiles[i] == run.xTile) && (yTiles[i] == run.yTile);
+
+        if (sameTile && ((interval*24.0*60.0*60.0) <= requiredTraceInterval))
+        {
+            run.duraTime += interval;
+            if ((spans.size() > spanIdx) && (spans.back().second == saveTime))
+                spans.back().second = currTime;
+            else
+                spans.emplace_back(saveTime, currTime);
+        }
+        totTraceInterval += interval;
+        if (interval > maxTraceInterval)
+        {
+            maxTraceInterval = interval;
+            maxIntervalIdx = i;
+        }
+        if ((interval*24.0*60.0*60.0 < minTraceInterval) && (interval*24.0*60.0*60.0 > 0))
+            minTraceInterval = interval*24.0*60.0*60.0;
+        totHrs += interval * 24;
+        if ((interval > 0) || !sameTile)
+        {
+            traceRecCnt += 1;
+            run.traceCnt += 1;
+        }
+
+        if (sameTile)
+        {
+            run.pointCnt += 1;
+            run.maxGap = max(run.maxGap, interval);
+            continue;
+        }
+        run.endTime = saveTime;
+        run.YYYYMMDD = traceRecs[i - 1].YYYYMMDD;
+        run.spanCnt = spans.size() - spanIdx;
+        runs.push_back(run);
+
+        run = traceRunStruct();
+        run.xTile = xTiles[i];
+        run.yTile = yTiles[i];
+        run.startTime = currTime;
+        run.pointCnt = 1;
+        spanIdx = spans.size();
+    }
+    run.endTime = traceRecs[traceCnt - 1].dayNum;
+    run.YYYYMMDD = traceRecs[traceCnt - 1].YYYYMMDD;
+    run.spanCnt = spans.size() - spanIdx;
+    runs.push_back(run);
+
+    day.totHrs = totHrs;
+    day.totTraceInterval = totTraceInterval;
+    day.maxTraceInterval = maxTraceInterval;
+    day.maxTraceIntervalHHMMSS = (maxTraceInterval > 0.0) ? formatTraceTime(traceRecs[maxIntervalIdx].HHMMSS) : "";
+    day.minTraceInterval = minTraceInterval;
+    day.traceRecCnt = traceRecCnt;
+    day.locChanges = runs.size() - 1;
+    day.singleRec = (traceCnt == 1);
+}
+
+/**
+*
+* Make a day's stays from its runs (see compactRuns()), one each: the last one is still open at
+* the end of the file
+*
+**/
+void runStays(dayStaysStruct &day)
+{
+    day.stays.resize(day.runs.size());
+    size_t spanIdx = 0;
+    for (size_t r = 0; r < day.runs.size(); r++)
+    {
+        const traceRunStruct &run = day.runs[r];
+        stayStruct &stay = day.stays[r];
+        stay = stayStruct();
+        stay.xTile = run.xTile;
+        stay.yTile = run.yTile;
+        stay.duraTime = run.duraTime;
+        stay.traceCnt = run.traceCnt;
+        stay.YYYYMMDD = run.YYYYMMDD;
+        stay.closed = (r + 1 < day.runs.size());
+        stay.spanIdx = spanIdx;
+        stay.spanCnt = run.spanCnt;
+        spanIdx += run.spanCnt;
+    }
+    day.openStay = day.stays.back();
+}
+
+/**
+*
+* Start a day's stays (see findStays()) at its first trace record firstRec, in tile xTile,yTile
+*
+**/
+void beginStays(const traceStruct &firstRec, int xTile, int yTile, dayStaysStruct &day)
+{
+    day.stays.clear();
+    day.spans.clear();
+    day.totHrs = 0.0;
+    day.totTraceInterval = 0.0;
+    day.maxTraceInterval = 0.0;
+    day.maxTraceIntervalHHMMSS.clear();
+    day.minTraceInterval = HUGE_VAL;
+    day.traceRecCnt = 1;                // the first record
+    day.locChanges = 0;
+    day.singleRec = true;
+
+    day.openStay = stayStruct();
+    day.openStay.xTile = xTile;
+    day.openStay.yTile = yTile;
+    day.openStay.latitude = day.openStay.latSum = firstRec.latitude;
+    day.openStay.longitude = day.openStay.lonSum = firstRec.longitude;
+    day.openStay.fixCnt = 1;
+    day.openStay.traceCnt = 1;          // the first record counts for the first stay
+}
+
+/**
+*
+* Start a day's stays with the stay open at the end of the day before still open (--split-days):
+* the day's totals start again, the stay keeps its time and spans and ends in this day or later
+*
+**/
+void carryStays(dayStaysStruct &day)
+{
+    stayStruct &stay = day.openStay;
+    day.spans.erase(day.spans.begin(), day.spans.begin() + stay.spanIdx);
+    stay.spanIdx = 0;
+    day.stays.clear();
+    day.totHrs = 0.0;
+    day.totTraceInterval = 0.0;
+    day.maxTraceInterval = 0.0;
+    day.maxTraceIntervalHHMMSS.clear();
+    day.minTraceInterval = HUGE_VAL;
+    day.traceRecCnt = 0;                // the stay's records so far were counted in their own days
+    day.locChanges = 0;
+    day.singleRec = false;
+}
+
+/**
+*
+* Add the day's next trace record traceRec, in tile xTile,yTile, to its stays. prevRec is the
+* record before it. A change of tile (with placeRadius km, a record farther than that from the
+* stay's first one) ends the open stay with prevRec.
+*
+**/
+void addStayRec(const traceStruct &prevRec, const traceStruct &traceRec, int xTile, int yTile,
+                int requiredTraceInterval, double placeRadius, dayStaysStruct &day, ostream &logOut)
+{
+    stayStruct &stay = day.openStay;
+    double saveTime = prevRec.dayNum;
+    double currTime = traceRec.dayNum;
+    bool   sameTile = (placeRadius > 0.0) ?
+                      (distanceEarth(stay.latitude, stay.longitude, traceRec.latitude, traceRec.longitude) <= placeRadius) :
+                      ((xTile == stay.xTile) && (yTile == stay.yTile));
+
+    logAt(LOG_TRACE, logOut) << "xTileCurr=" << xTile << ", yTileCurr=" << yTile << endl;
+    day.singleRec = false;
+    if (sameTile)
+    {
+        stay.latSum += traceRec.latitude;
+        stay.lonSum += traceRec.longitude;
+        stay.fixCnt += 1;
+    }
+
+    if ((((currTime - saveTime)*24.0*60.0*60.0) <= requiredTraceInterval) && sameTile)
+    {
+        stay.duraTime += currTime - saveTime;       // add time difference since last log record to accumulated time
+        if ((day.spans.size() > stay.spanIdx) && (day.spans.back().second == saveTime))
+            day.spans.back().second = currTime;
+        else
+            day.spans.emplace_back(saveTime, currTime);
+    }
+
+    /** Get trace intervals for max, min, and average **/
+    day.totTraceInterval += (currTime - saveTime);
+    if ((currTime - saveTime) > day.maxTraceInterval)
+    {
+        day.maxTraceInterval = currTime - saveTime;     // keep track of longest interval
+        day.maxTraceIntervalHHMMSS = formatTraceTime(traceRec.HHMMSS);
+    }
+    if (((currTime - saveTime)*24.0*60.0*60.0 < day.minTraceInterval) &&
+        ((currTime - saveTime)*24.0*60.0*60.0 > 0))    // Ignore trace intervals of zero
+        day.minTraceInterval = (currTime - saveTime)*24.0*60.0*60.0;
+
+    /** total hours for all traces, not just qualifying locations **/
+    day.totHrs += (currTime - saveTime) * 24;
+
+    /** Don't count trace records in same tile w/same time stamp (possible airplane travel) **/
+    if (((currTime - saveTime) > 0) || !sameTile)
+    {
+        day.traceRecCnt += 1;
+        stay.traceCnt += 1;
+    }
+
+    /** Control break if new tile coordinates: the stay ends with the record before this one **/
+    if (!sameTile)
+    {
+        logAt(LOG_TRACE, logOut) << "duraTime=" << stay.duraTime << endl;
+        stay.YYYYMMDD = prevRec.YYYYMMDD;
+        stay.closed = true;
+        stay.spanCnt = day.spans.size() - stay.spanIdx;
+        day.stays.push_back(stay);
+        day.locChanges += 1;
+
+        stay = stayStruct();
+        stay.xTile = xTile;
+        stay.yTile = yTile;
+        stay.latitude = stay.latSum = traceRec.latitude;
+        stay.longitude = stay.lonSum = traceRec.longitude;
+        stay.fixCnt = 1;
+        stay.spanIdx = day.spans.size();
+    }
+}
+
+/**
+*
+* End a day's stays at its last trace record lastRec: the open stay is added to the stays,
+* still open at the end of the file
+*
+**/
+void endStays(const traceStruct &lastRec, dayStaysStruct &day)
+{
+    stayStruct &stay = day.openStay;
+    stay.YYYYMMDD = lastRec.YYYYMMDD;
+    stay.closed = false;
+    stay.spanCnt = day.spans.size() - stay.spanIdx;
+    day.stays.push_back(stay);
+}
+
+/**
+*
+* Apply one day's stays to the subject's MACH2K totals and records at param.timeInPlace: add or
+* update a MACH2K record for every stay of at least timeInPlace. The stay still open at the end
+* of the file counts as a location only if it qualifies (or is the file's only record).
+*
+**/
+void applyStays(const dayStaysStruct &day, const string &fileNameDateTime, const runParamStruct &param,
+                subjectStruct &subj, ostream &logOut)
+{
+    stageTimer timer(STAGE_APPLY);
+    vector<mach2kStruct> &mach2kRec = subj.mach2kRec;
+    int   &machRecCnt = subj.machRecCnt;
+    double timeInPlace = param.timeInPlace;
+    bool   totQualDaysCntUpdate = false; // to determine if input file had at least one qualifying location/duration
+
+    subj.traceRecCnt += day.traceRecCnt;
+    subj.totTraceInterval += day.totTraceInterval;    // Get total intervals added together to divide by traceCnt @EOF
+    subj.totHrsCnt += day.totHrs;
+    if (day.maxTraceInterval > subj.maxTraceInterval)
+    {
+        subj.maxTraceInterval = day.maxTraceInterval;
+        subj.maxTraceIntervalHHMMSS = day.maxTraceIntervalHHMMSS;
+    }
+    if (day.minTraceInterval < subj.minTraceInterval)
+        subj.minTraceInterval = day.minTraceInterval;
+
+    /** increment total location changes counter if changed location regardless of how much time in location **/
+    /** ISSUE: What if sampling rate is 1 second and moving very fast? Would skew towards more locations **/
+    subj.totLocsCnt += day.locChanges;
+
+    for (const stayStruct &stay : day.stays)
+    {
+        /** Handle situation where all records within one tile, for the whole file (happens at low zoom levels) **/
+        if (!stay.closed)
+        {
+            if (!day.singleRec && (stay.duraTime < timeInPlace))
+                continue;
+            subj.totLocsCnt += 1;
+            totQualDaysCntUpdate = true;
+        }
+
+        /** Has this location accumulated enough time (duraTime) to be stored in MACH2k.txt file? **/
+        if (stay.duraTime < timeInPlace)
+            continue;
+        logAt(LOG_DEBUG, logOut) << "xTileSave=" << stay.xTile << ", yTileSave=" << stay.yTile << ", duraTime=" << stay.duraTime << endl;
+        countStat(COUNT_QUAL_STAYS, 1);
+        totQualDaysCntUpdate = true;   // so we can increment the totQualDaysCnt value for header record
+
+        /** Save smallest and largest x,y tiles for qualifying tiles for output file header for range of locations **/
+        if (stay.xTile < subj.minXtile)
+            subj.minXtile = stay.xTile;
+        if (stay.yTile < subj.minYtile)
+            subj.minYtile = stay.yTile;
+        if (stay.xTile > subj.maxXtile)
+            subj.maxXtile = stay.xTile;
+        if (stay.yTile > subj.maxYtile)
+            subj.maxYtile = stay.yTile;
+
+        /** increment duration if changed location qualifies for time in location **/
+        subj.totQualDura += stay.duraTime * 24.0;
+
+        int qualTraceCnt = stay.traceCnt + 1;       // Count traces during qualifying locations to prevent spoofing
+        subj.totQualTraceCnt += qualTraceCnt;
+
+        /** Hour, dow and month are not part of the key yet, see tileKey(). With --place-radius, the nearest place **/
+        double placeRadius = param.placeRadius/1000.0;
+        double stayLat = stay.latSum/stay.fixCnt, stayLon = stay.lonSum/stay.fixCnt;
+        int bestMachRecIdx = (param.placeRadius > 0) ? findPlace(subj.places, placeRadius, stayLat, stayLon) :
+                                                       findTileRec(subj.tileIndex, tileKey(stay.xTile, stay.yTile));
+        logAt(LOG_DEBUG, logOut) << "bestMachRecIdx=" << bestMachRecIdx << ", qualTraceCnt=" << qualTraceCnt << endl;
+
+        /** Update existing MACH2K record with same xTile,yTile coordinates **/
+        if (bestMachRecIdx != -1)
+        {
+            mach2kStruct &machRec = mach2kRec[bestMachRecIdx];
+            machRec.freq += 1;
+            machRec.dura = roundDuraHours(machRec.dura + stay.duraTime * 24.0); // add duration time in hrs to existing value
+            machRec.traceCnt += qualTraceCnt;
+            machRec.lastYYYYMMDD = stay.YYYYMMDD;
+            countStat(COUNT_RECS_UPDATED, 1);
+        } // updated existing MACH2K record
+        else
+        {
+            /** Create new MACH2K record **/
+            bestMachRecIdx = machRecCnt;
+            mach2kRec.emplace_back();
+            subj.dwellHist.emplace_back();
+            mach2kStruct &machRec = mach2kRec.back();
+            machRec.xTile = stay.xTile;
+            machRec.yTile = stay.yTile;
+            if (param.placeRadius > 0)
+                insertPlace(subj.places, placeRadius, stayLat, stayLon);
+            else
+                insertTileRec(subj.tileIndex, tileKey(stay.xTile, stay.yTile), machRecCnt);
+
+            machRec.hour = 99;          // set from dwellHist below
+            machRec.dow = 9;
+            machRec.freq = 1;
+            machRec.dura = roundDuraHours(stay.duraTime * 24.0);
+            machRec.traceCnt = qualTraceCnt;
+            machRec.firstYYYYMMDD = stay.YYYYMMDD;
+            machRec.lastYYYYMMDD = machRec.firstYYYYMMDD;
+            machRecCnt += 1;
+            countStat(COUNT_RECS_INSERTED, 1);
+            logAt(LOG_DEBUG, logOut) << "NEW REC: updated machRecCnt=" << machRecCnt << ", mach2kRec.dura=" << machRec.dura << endl;
+        } // end if no record for this location yet in MACH2K file
+
+        /** Add the stay to the location's hour of week histogram **/
+        addDwellHist(subj.dwellHist[bestMachRecIdx], mach2kRec[bestMachRecIdx], day.spans.data() + stay.spanIdx, stay.spanCnt);
+    } // for each stay
+
+    if (totQualDaysCntUpdate)  // true if this input file had at least one qualifying location/duration
+        ++subj.totQualDaysCnt;
+
+    /** First file for this subject sets the first date/time; every file moves the last date/time **/
+    if (!subj.m2kLoaded)
+        subj.firstDateTime = fileNameDateTime;
+    subj.lastDateTime = fileNameDateTime;
+    ++subj.totDaysCnt;
+    subj.m2kLoaded = true;
+}
+
+/**
+*
+* Apply one day's trace records, already projected to tiles, to the subject's MACH2K totals and
+* records: findStays() then applyStays() at param.timeInPlace.
+*
+**/
+void processTraceRecs(const traceStruct traceRecs[], const int xTiles[], const int yTiles[], size_t traceCnt,
+                      const string &fileNameDateTime, const runParamStruct &param, subjectStruct &subj, ostream &logOut)
+{
+    dayStaysStruct day;
+    findStays(traceRecs, xTiles, yTiles, traceCnt, param.requiredTraceInterval, param.placeRadius/1000.0, day, logOut);
+    applyStays(day, fileNameDateTime, param, subj, logOut);
+}
+
+/**
+*
+* Engine for subjectName at each params entry, with no days yet (see restore() and subject()
+* to start from a saved state). Params entries of the same zoom level (trace interval and place
+* radius) share the stays found in each day.
+*
+**/
+mach2kEngine::mach2kEngine(const vector<runParamStruct> &runParams, const string &subjectName, ostream &logOut)
+    : params(runParams), subjs(runParams.size()), applyDay(runParams.size(), false),
+      previews(runParams.size()), logOut(&logOut)
+{
+    for (size_t p = 0; p < params.size(); p++)
+    {
+        subjs[p].subject = subjectName;
+        size_t g = 0;
+        while ((g < groupParam.size()) &&
+               ((params[groupParam[g]].zoomLevel != params[p].zoomLevel) ||
+                (params[groupParam[g]].requiredTraceInterval != params[p].requiredTraceInterval) ||
+                (params[groupParam[g]].placeRadius != params[p].placeRadius)))
+            g++;
+        if (g == groupParam.size())
+            groupParam.push_back(p);
+        paramGroup.push_back(g);
+        if (params[p].zoomLevel > params[finest].zoomLevel)
+            finest = p;
+    }
+    days.resize(groupParam.size());
+    splitDays = !params.empty() && params[0].splitDays;
+}
+
+/**
+*
+* True if a day (trace file) named by this YYYYMMDDHHMMSS date/time is later than the last one
+* at some params entry. A day at or before every entry's last date/time was already counted.
+*
+**/
+bool mach2kEngine::takesDay(const string &fileNameDateTime) const
+{
+    for (const subjectStruct &subj : subjs)
+        if (!subj.m2kLoaded || (fileNameDateTime > subj.lastDateTime))
+            return true;
+    return false;
+}
+
+/**
+*
+* Start a day named by fileNameDateTime: each params entry takes it if the date/time is later
+* than its last one. Totals are rounded between days the same as a write and reread of
+* MACH2K.txt. Returns 0, or 6 if no params entry takes the day.
+*
+**/
+int mach2kEngine::beginDay(const string &fileNameDateTime)
+{
+    if (!takesDay(fileNameDateTime))
+        return 6;
+
+    for (size_t p = 0; p < subjs.size(); p++)
+    {
+        subjectStruct &subj = subjs[p];
+        logAt(LOG_DEBUG, *logOut) << "FileNameDateTime=" << fileNameDateTime << ",lastDateTime=" << subj.lastDateTime << endl;
+        applyDay[p] = !subj.m2kLoaded || (fileNameDateTime > subj.lastDateTime);
+        if (subj.m2kLoaded)
+            roundTripTotals(subj);
+
+        dayPreviewStruct &preview = previews[p];
+        preview.totals = subjectTotals(subj);
+        preview.qualDay = false;
+        fill(preview.newTiles.recIdx.begin(), preview.newTiles.recIdx.end(), -1);
+        preview.newTiles.used = 0;
+        preview.newPlaces.centers.clear();
+        preview.newPlaces.cells.clear();
+    }
+    dayDateTime = fileNameDateTime;
+    return 0;
+}
+
+/**
+*
+* Add one trace record to the open day. A record of a later date ends the open day first, the
+* same as the next day's trace file, and a new day is named by the date/time of its first
+* record. With --split-days the stay open at the change of date goes on into the new day if
+* the record is at most the trace interval later (see carriesStay()), and a record before the
+* last one is rejected too. Returns 0, or 6 if the record's date is before the open day's, or
+* its day is not later than the last date/time at any params entry.
+*
+**/
+int mach2kEngine::ingest(const traceStruct &traceRec)
+{
+    char dateTime[32];                  // YYYYMMDDHHMMSS of the record, if it starts a day
+    if (!openDay || (traceRec.YYYYMMDD != lastRec.YYYYMMDD))
+        snprintf(dateTime, sizeof(dateTime), "%08u%06u", traceRec.YYYYMMDD, traceRec.HHMMSS);
+    bool carried = false;               // the new day may go on from the last record of the one before
+    if (openDay && (traceRec.YYYYMMDD != lastRec.YYYYMMDD))
+    {
+        if (traceRec.YYYYMMDD < lastRec.YYYYMMDD)
+            return 6;
+        /** A day no params entry takes ends with its open stay, nothing goes on into it **/
+        carried = splitDays && takesDay(dateTime);
+        endDay(carried ? &traceRec : nullptr);
+    }
+    else
+    if (splitDays && openDay && (traceRec.dayNum < lastRec.dayNum))
+        return 6;
+
+    int xTile, yTile;
+    projectTiles(&traceRec, 1, params[finest].numTiles, &xTile, &yTile);
+    bool newDay = !openDay;
+    if (newDay)
+    {
+        int status = beginDay(dateTime);
+        if (status != 0)
+            return status;
+        openDay = true;
+    }
+    for (size_t g = 0; g < days.size(); g++)
+    {
+        const runParamStruct &groupRun = params[groupParam[g]];
+        int shift = params[finest].zoomLevel - groupRun.zoomLevel;
+        if (newDay && !(carried && carriesStay(g, traceRec)))
+        {
+            beginStays(traceRec, xTile / (1 << shift), yTile / (1 << shift), days[g]);
+            continue;
+        }
+        if (newDay)
+            carryStays(days[g]);
+        size_t stayCnt = days[g].stays.size();
+        addStayRec(lastRec, traceRec, xTile / (1 << shift), yTile / (1 << shift), groupRun.requiredTraceInterval,
+                   groupRun.placeRadius/1000.0, days[g], *logOut);
+        if (days[g].stays.size() > stayCnt)
+            previewStay(g, days[g].stays.back());
+    }
+    lastRec = traceRec;
+    return 0;
+}
+
+/**
+*
+* True if the stay open at the end of the day goes on to nextRec, the first record of the next
+* date (--split-days): nextRec is at most the group's trace interval after the day's last record.
+* After a longer gap the next day starts its stays and totals again, the same as a new trace file.
+*
+**/
+bool mach2kEngine::carriesStay(size_t group, const traceStruct &nextRec) const
+{
+    return splitDays &&
+           ((nextRec.dayNum - lastRec.dayNum)*24.0*60.0*60.0 <= params[groupParam[group]].requiredTraceInterval);
+}
+
+/**
+*
+* Apply a stay of the open day that just closed to the previews of the group's params entries,
+* the same as applyStays() will at the end of the day
+*
+**/
+void mach2kEngine::previewStay(size_t group, const stayStruct &stay)
+{
+    for (size_t p = 0; p < params.size(); p++)
+    {
+        if ((paramGroup[p] != group) || !applyDay[p] || (stay.duraTime < params[p].timeInPlace))
+            continue;
+        dayPreviewStruct &preview = previews[p];
+        preview.qualDay = true;
+        addQualTotals(preview.totals, stay);
+        if (newPlace(p, stay))
+        {
+            if (params[p].placeRadius > 0)
+                insertPlace(preview.newPlaces, params[p].placeRadius/1000.0, stay.latSum/stay.fixCnt, stay.lonSum/stay.fixCnt);
+            else
+                insertTileRec(preview.newTiles, tileKey(stay.xTile, stay.yTile), preview.totals.machRecCnt);
+            preview.totals.machRecCnt += 1;
+        }
+    }
+}
+
+/**
+*
+* True if a qualifying stay would add a MACH2K record at params entry paramIdx: its tile (or
+* with --place-radius, a place within it) has no record and no earlier stay of the open day
+*
+**/
+bool mach2kEngine::newPlace(size_t paramIdx, const stayStruct &stay) const
+{
+    const dayPreviewStruct &preview = previews[paramIdx];
+    if (params[paramIdx].placeRadius > 0)
+    {
+        double placeRadius = params[paramIdx].placeRadius/1000.0;
+        double stayLat = stay.latSum/stay.fixCnt, stayLon = stay.lonSum/stay.fixCnt;
+        return (findPlace(subjs[paramIdx].places, placeRadius, stayLat, stayLon) == -1) &&
+               (findPlace(preview.newPlaces, placeRadius, stayLat, stayLon) == -1);
+    }
+    uint64_t key = tileKey(stay.xTile, stay.yTile);
+    return (findTileRec(subjs[paramIdx].tileIndex, key) == -1) && (findTileRec(preview.newTiles, key) == -1);
+}
+
+/**
+*
+* End the open day: its stays are applied to each params entry that takes it, the same as the
+* end of a trace file. Given the next date's first record nextRec (--split-days), a zoom level
+* whose open stay goes on to it applies only the closed stays; the open stay is left to go on
+* into the next day (see carriesStay() and carryStays()). Nothing to do if no day is open.
+*
+**/
+void mach2kEngine::endDay(const traceStruct *nextRec)
+{
+    if (!openDay)
+        return;
+    for (size_t g = 0; g < days.size(); g++)
+        if (!nextRec || !carriesStay(g, *nextRec))
+            endStays(lastRec, days[g]);
+    for (size_t p = 0; p < subjs.size(); p++)
+        if (applyDay[p])
+            applyStays(days[paramGroup[p]], dayDateTime, params[p], subjs[p], *logOut);
+    openDay = false;
+    endedDayCnt += 1;
+}
+
+/**
+*
+* Apply one day's trace records (a trace file, in file order) named by fileNameDateTime. The
+* records are projected once, at the finest zoom level; the tiles of a coarser zoom level z
+* are those divided by 2^(finest - z), the same tiles as projecting at z since scaling by a
+* power of 2 is exact. The stays are found once per zoom level and applied at each secs. in
+* place. An open day of ingest() records is ended first. Returns 0, 6 if no params entry
+* takes the day, or 10 if there are no records.
+*
+**/
+int mach2kEngine::ingestDay(const traceStruct traceRecs[], size_t traceCnt, const string &fileNameDateTime)
+{
+    endDay();
+    int status = beginDay(fileNameDateTime);
+    if (status != 0)
+        return status;
+    if (traceCnt == 0)
+        return 10;
+
+    xTiles.resize(traceCnt);
+    yTiles.resize(traceCnt);
+    projectTiles(traceRecs, traceCnt, params[finest].numTiles, xTiles.data(), yTiles.data());
+
+    for (size_t g = 0; g < days.size(); g++)
+    {
+        int shift = params[finest].zoomLevel - params[groupParam[g]].zoomLevel;
+        const int *xZoom = xTiles.data(), *yZoom = yTiles.data();
+        if (shift != 0)
+        {
+            /** Division, not >>, truncates toward zero the same as projectTile() (off-map latitudes are negative) **/
+            stageTimer timer(STAGE_PROJECT);
+            xZoomTiles.resize(traceCnt);
+            yZoomTiles.resize(traceCnt);
+            for (size_t i = 0; i < traceCnt; i++)
+            {
+                xZoomTiles[i] = xTiles[i] / (1 << shift);
+                yZoomTiles[i] = yTiles[i] / (1 << shift);
+            }
+            xZoom = xZoomTiles.data();
+            yZoom = yZoomTiles.data();
+        }
+        findStays(traceRecs, xZoom, yZoom, traceCnt, params[groupParam[g]].requiredTraceInterval,
+                  params[groupParam[g]].placeRadius/1000.0, days[g], *logOut);
+
+        /** Every secs. in place at this zoom level takes the same stays **/
+        for (size_t p = 0; p < subjs.size(); p++)
+            if ((paramGroup[p] == g) && applyDay[p])
+                applyStays(days[g], fileNameDateTime, params[p], subjs[p], *logOut);
+    }
+    endedDayCnt += 1;
+    return 0;
+}
+
+/**
+*
+* Apply one day's stays found before (a visit log day, see readVisitDay()) named by
+* fileNameDateTime at every params entry, which must all be of the zoom level, trace interval
+* and places they were found with. An open day of ingest() records is ended first. Returns 0,
+* or 6 if no params entry takes the day.
+*
+**/
+int mach2kEngine::ingestStays(const dayStaysStruct &day, const string &fileNameDateTime)
+{
+    endDay();
+    int status = beginDay(fileNameDateTime);
+    if (status != 0)
+        return status;
+
+    for (size_t p = 0; p < subjs.size(); p++)
+        if (applyDay[p])
+            applyStays(day, fileNameDateTime, params[p], subjs[p], *logOut);
+    endedDayCnt += 1;
+    return 0;
+}
+
+/**
+*
+* TRUST value at params entry paramIdx (see machTrust()), with the open day so far as if it
+* ended at its last record. Only the open stay is added to the totals kept as each stay
+* closed, so this is O(1) however many trace records and locations there are.
+*
+**/
+double mach2kEngine::trust(size_t paramIdx) const
+{
+    if (!openDay || !applyDay[paramIdx])
+        return machTrust(params[paramIdx], subjectTotals(subjs[paramIdx]));
+
+    const dayStaysStruct &day = days[paramGroup[paramIdx]];
+    const stayStruct &stay = day.openStay;
+    const dayPreviewStruct &preview = previews[paramIdx];
+    mach2kTotalsStruct totals = preview.totals;
+    bool qualDay = preview.qualDay;
+
+    /** The same as applyStays() with the open stay still open at the end of the file **/
+    totals.totHrsCnt += day.totHrs;
+    totals.totLocsCnt += day.locChanges;
+    if (day.singleRec || (stay.duraTime >= params[paramIdx].timeInPlace))
+    {
+        totals.totLocsCnt += 1;
+        qualDay = true;
+    }
+    if (stay.duraTime >= params[paramIdx].timeInPlace)
+    {
+        addQualTotals(totals, stay);
+        if (newPlace(paramIdx, stay))
+            totals.machRecCnt += 1;
+    }
+    totals.totDaysCnt += 1;
+    if (qualDay)
+        totals.totQualDaysCnt += 1;
+    return machTrust(params[paramIdx], totals);
+}
+
+/**
+*
+* The state at params entry paramIdx, in the binary state file layout (see writeMach2kState()).
+* An open day is not in it until endDay().
+*
+**/
+void mach2kEngine::snapshot(size_t paramIdx, string &stateBytes) const
+{
+    buildMach2kState(params[paramIdx], subjs[paramIdx], stateBytes);
+}
+
+/**
+*
+* Replace the state at params entry paramIdx with a snapshot() (or state file contents) of
+* the same zoom level and secs. in place. Returns 0 or the readMach2kState() exit code.
+*
+**/
+int mach2kEngine::restore(size_t paramIdx, const char *stateBytes, size_t stateSize)
+{
+    runParamStruct fileParam = params[paramIdx];
+    subjectStruct restored;
+    int status = parseMach2kState(stateBytes, stateSize, "snapshot", fileParam, restored, *logOut);
+    if (status == 0)
+        subjs[paramIdx] = move(restored);
+    return status;
+}
+
+/**
+*
+* The subject's MACH2K header totals the TRUST value is taken from
+*
+**/
+mach2kTotalsStruct subjectTotals(const subjectStruct &subj)
+{
+    mach2kTotalsStruct totals;
+    totals.totDaysCnt = subj.totDaysCnt;
+    totals.totHrsCnt = subj.totHrsCnt;
+    totals.totLocsCnt = subj.totLocsCnt;
+    totals.totQualDura = subj.totQualDura;
+    totals.totQualDaysCnt = subj.totQualDaysCnt;
+    totals.minXtile = subj.minXtile;
+    totals.minYtile = subj.minYtile;
+    totals.maxXtile = subj.maxXtile;
+    totals.maxYtile = subj.maxYtile;
+    totals.machRecCnt = subj.machRecCnt;
+    return totals;
+}
+
+/**
+*
+* Add a qualifying stay's tile range and hours to totals, as applyStays() does to the subject
+*
+**/
+void addQualTotals(mach2kTotalsStruct &totals, const stayStruct &stay)
+{
+    if (stay.xTile < totals.minXtile)
+        totals.minXtile = stay.xTile;
+    if (stay.yTile < totals.minYtile)
+        totals.minYtile = stay.yTile;
+    if (stay.xTile > totals.maxXtile)
+        totals.maxXtile = stay.xTile;
+    if (stay.yTile > totals.maxYtile)
+        totals.maxYtile = stay.yTile;
+    totals.totQualDura += stay.duraTime * 24.0;
+}
+
+/**
+*
+* TRUST value of a subject's MACH2K totals, between 0 and 1 (0 if there are fewer than 3
+* qualifying locations or they cover 1000 km^2 or more), as written to the MACH2K.txt header
+*
+**/
+double machTrust(const runParamStruct &param, const mach2kTotalsStruct &totals)
+{
+    const trustModelStruct &trust = param.trust;
+    double machTrust = 0.0;              // Trust value between 0 and 1
+    double factor[TRUST_FACTOR_CNT];
+
+    if (trustFactors(param, totals, factor))
+    {
+        /** Calculate TRUST value, each factor divided by observed avg. + 1 standard deviation, equal weights by default **/
+        for (int f = 0; f < TRUST_FACTOR_CNT; f++)
+            machTrust += trust.weight[f]*(factor[f]/trust.norm[f]);
+
+        if (totals.totDaysCnt < trust.fullDays)
+            machTrust = machTrust * (totals.totDaysCnt/trust.fullDays);     // Adjust trust if < 30 total days of data
+    }
+    return machTrust;           // if no qualifying days yet, TRUST=0
+}
+
+/**
+*
+* The TRUST factors of a subject's MACH2K totals, in TRUST_FACTOR_NAMES order. Returns false
+* if the subject gets TRUST=0: no days, fewer than trust.minQualLocs qualifying locations or
+* their bounding area is trust.maxArea km^2 or more.
+*
+**/
+bool trustFactors(const runParamStruct &param, const mach2kTotalsStruct &totals, double factor[])
+{
+    const trustModelStruct &trust = param.trust;
+    double tileLength = param.tileLength;
+    int    minXtile = totals.minXtile;
+
+    if (minXtile == 999999)
+        minXtile = 0;
+    double boundArea = ((totals.maxXtile-minXtile+1)*tileLength)*((totals.maxYtile-totals.minYtile+1)*tileLength);
+
+    factor[0] = totals.totQualDura/totals.totQualDaysCnt;
+    factor[1] = totals.machRecCnt/totals.totQualDaysCnt;
+    factor[2] = totals.totQualDaysCnt/totals.totDaysCnt;
+    factor[3] = totals.machRecCnt/totals.totLocsCnt;
+    factor[4] = totals.totQualDura/totals.totHrsCnt;
+    factor[5] = (totals.machRecCnt*trust.tileArea)/boundArea;     // QualLocs area in km^2 / QualLocs boundary area in km^2
+
+    return (totals.totDaysCnt > 0) && (boundArea < trust.maxArea) && (totals.machRecCnt >= trust.minQualLocs);
+}
+
+/**
+*
+* Write the subject's MACH2K header and records to MACH2K.txt, replacing the old file in one
+* step (see writeFileAtomic()). Returns 0 or the program exit code.
+*
+**/
+int writeMach2kFile(const string &m2kName, const runParamStruct &param, subjectStruct &subj, ostream &logOut)
+{
+    stageTimer timer(STAGE_M2K_WRITE);
+    ostringstream outFileM2K;           // MACH2K.txt contents, written once complete
+    mach2kStruct *mach2kRec = subj.mach2kRec.data();
+    int    machRecCnt = subj.machRecCnt;
+    double tileLength = param.tileLength;
+    double totDaysCnt = subj.totDaysCnt, totHrsCnt = subj.totHrsCnt, totLocsCnt = subj.totLocsCnt;
+    double totQualDura = subj.totQualDura, totQualDaysCnt = subj.totQualDaysCnt;
+    int    minXtile = subj.minXtile, minYtile = subj.minYtile, maxXtile = subj.maxXtile, maxYtile = subj.maxYtile;
+
+    /** Write MACH2K records, if any, from memory and then MACH2K.txt file **/
+
+    logAt(LOG_DEBUG, logOut) << "About to write to MACH2K file, machRecCnt=" << machRecCnt << endl;
+
+    if (minXtile == 999999)
+        minXtile = 0;
+    // Write file headers with summary info
+    outFileM2K << "xTile,yTile,Hour,DOW,Freq,Hours Duration,FirstDate,LastDate\n";
+    outFileM2K << "zoom level=" << param.zoomLevelStr << ", seconds=" << param.durationStr << ", version=" << param.version << "\n";
+    outFileM2K << "1st date/time,Last date/time,Tot days,Tot hrs,Tot locs,Qual locs,"
+               << "Tot qual hrs,Tot qual days,Qual hrs/Tot hrs %,Min xTile,Min yTile,Max xTile,Max yTile,"
+               << "#1 loc%,#2 loc%,#3 loc%,#4 loc%,#5 loc%,#6 loc%,Subject,"
+               << "QH/Qdays,QL/Qdays,QD/TD,QL km^2,QL bound km^2,km^2 Density,QL/TL,QH/TH,TRUST,"
+               << "Trace Cnt,Max Interval,Max Interval HHMMSS,Min Interval,Cumm. Trace Secs.,Traces/Day,Avg Interval,"
+               << "Tot Qual Trace Cnt,Week Regularity\n";
+
+    outFileM2K << subj.firstDateTime << ','             // 1st date/time
+               << subj.lastDateTime << ','              // Last date/time
+               << totDaysCnt << ','                     // Tot days
+               << totHrsCnt << ','                      // Tot hrs
+               << totLocsCnt << ','                     // Tot locs
+               << machRecCnt << ','                     // Qual locs
+               << totQualDura << ','                    // Tot qual hrs
+               << totQualDaysCnt << ','                 // Tot qual days
+               << (totQualDura/totHrsCnt)*100.00 << ','    // Qual hrs/Tot hrs
+               << minXtile << ','                       // Min xTile
+               << minYtile << ','                       // Min yTile
+               << maxXtile << ','                       // Max xTile
+               << maxYtile << ',';                      // Max yTile
+
+    // Write the top six location durations (checking to be sure we have six records) to the header
+    int topIdx[6];
+    int topCnt = topLocations(mach2kRec, machRecCnt, 6, topIdx);
+    for (int i=0; i<6; i++)
+        if (i >= topCnt)
+            outFileM2K << 0.00 << ',';
+        else
+            outFileM2K << ((float)mach2kRec[topIdx[i]].dura/totQualDura)*100.00 << ','; //#1-#6 loc%, float as read by stof() before
+
+    outFileM2K << subj.subject << ',';                  // Subject
+
+    if (totQualDaysCnt > 0)      // avoid division by zero
+        outFileM2K << totQualDura/totQualDaysCnt << ','
+                   << machRecCnt/totQualDaysCnt << ',';
+    else
+        outFileM2K << 0 << ','
+                   << 0 << ',';
+
+    outFileM2K << totQualDaysCnt/totDaysCnt << ','
+               << machRecCnt*.219961 << ','                                             //QL km^2
+               << ((maxXtile-minXtile+1)*tileLength)*((maxYtile-minYtile+1)*tileLength) << ','      //QL bound km^2
+               << ((machRecCnt*.219961)/(((maxXtile-minXtile+1.0)*tileLength)*((maxYtile-minYtile+1.0)*tileLength))) << ',' // Density
+               << machRecCnt/totLocsCnt << ','
+               << totQualDura/totHrsCnt << ',';
+
+    outFileM2K << machTrust(param, subjectTotals(subj)) << ',';     // May want to check for at least 30 consecutive days?
+
+    /** Add Trace Cnt and max, min, total intervals (in seconds) at end of header data **/
+    logAt(LOG_DEBUG, logOut) << "Writing: traceRecCnt=" << subj.traceRecCnt
+         << ",maxTraceInterval=" << subj.maxTraceInterval*24.0*60.0*60.0
+         << ", maxTraceIntervalHHMMSS=" << subj.maxTraceIntervalHHMMSS
+         << ",minTraceInterval=" << subj.minTraceInterval
+         << ",tot Trace Intervals=" << subj.totTraceInterval*24.0*60.0*60.0
+         << ", Traces per day=" << (subj.traceRecCnt/totDaysCnt)
+         << ",Avg. Trace=" << (subj.totTraceInterval*24.0*60.0*60.0)/((subj.traceRecCnt*1.0)-totDaysCnt) << endl;
+    outFileM2K  << subj.traceRecCnt << ','
+                << subj.maxTraceInterval*24.0*60.0*60.0 << ','
+                << subj.maxTraceIntervalHHMMSS << ','
+                << subj.minTraceInterval << ','
+                << subj.totTraceInterval*24.0*60.0*60.0 << ','
+                << subj.traceRecCnt/totDaysCnt << ','
+                << (subj.totTraceInterval*24.0*60.0*60.0)/((subj.traceRecCnt*1.0)-totDaysCnt) << ','
+                << subj.totQualTraceCnt << ','
+                << weekRegularity(subj.dwellHist.data(), machRecCnt) << "\n";
+
+    if (machRecCnt > 0)
+    {
+        logAt(LOG_DEBUG, logOut) << "Before mach2kRec(s) write, machRecCnt=" << machRecCnt << "mach2kRec[0].traceCnt=" << mach2kRec[0].traceCnt << endl;
+    }
+    /** Write data records by duration in descending order, Freq zero padded to 3 digits and  **/
+    /** Hours Duration to 10 characters so the columns sort as text                           **/
+    char freqStr[16], duraStr[32];
+    for (int i : sortLocations(mach2kRec, machRecCnt))
+    {
+        snprintf(freqStr, sizeof(freqStr), "%03u", mach2kRec[i].freq);
+        snprintf(duraStr, sizeof(duraStr), "%010.6f", mach2kRec[i].dura);
+        outFileM2K  << mach2kRec[i].xTile << ','
+                    << mach2kRec[i].yTile << ','
+                    << (int)mach2kRec[i].hour << ','
+                    << (int)mach2kRec[i].dow << ','
+//                       << (int)mach2kRec[i].mo << ','
+                    << freqStr << ','
+                    << duraStr << ','
+                    << mach2kRec[i].traceCnt << ','
+                    << formatTraceDate(mach2kRec[i].firstYYYYMMDD) << ','
+                    << formatTraceDate(mach2kRec[i].lastYYYYMMDD) << "\n";
+    }
+
+    int status = writeFileAtomic(m2kName, outFileM2K.str(), false, logOut);
+    if (status != 0)
+        return status;
+
+    return 0;
+}
+
+/**
+*
+* Map an existing binary NNN_MACH2K.bin state file and load it into the subject totals and records.
+* A missing file is not an error and leaves subj.m2kLoaded false. The run parameters must equal
+* param's, unless param.zoomLevelStr is empty: then param takes the file's (for -export-csv).
+* Returns 0 or the same exit codes as readMach2kFile().
+*
+**/
+int readMach2kState(const string &stateName, runParamStruct &param, subjectStruct &subj, ostream &logOut)
+{
+    stageTimer timer(STAGE_STATE_READ);
+    traceFileStruct stateFile;
+
+    if (!mapFile(stateName, stateFile))     // no state yet
+        return 0;
+    return parseMach2kState(stateFile.data, stateFile.size, stateName, param, subj, logOut);
+}
+
+/**
+*
+* Load a binary state file's contents (stateSize bytes at stateData, named stateName in the
+* messages) into the subject totals and records. Returns 0 or the readMach2kState() exit codes.
+*
+**/
+int parseMach2kState(const char *stateData, size_t stateSize, const string &stateName, runParamStruct &param,
+                     subjectStruct &subj, ostream &logOut)
+{
+    mach2kStateStruct header;
+
+    if ((stateSize < sizeof(header)) || (memcmp(stateData, M2K_STATE_MAGIC, sizeof(header.magic)) != 0))
+    {
+        logAt(LOG_ERROR, logOut) << "Invalid MACH2K state file " << stateName << ", no MACH2K header." << endl;
+        return 3;
+    }
+    memcpy(&header, stateData, sizeof(header));
+    if ((header.version < 1) || (header.version > M2K_STATE_VERSION) || (header.recSize != sizeof(mach2kStruct)))
+    {
+        logAt(LOG_ERROR, logOut) << "MACH2K state file " << stateName << " is version " << header.version
+               << ", this program reads version " << M2K_STATE_VERSION << ". Rebuild it from the trace files." << endl;
+        return 3;
+    }
+    size_t histSize = (header.version >= 2) ? sizeof(dwellHistStruct) : 0;    // version 1 had no histograms
+    if (header.version < 3)
+        header.placeRadius = 0;                                             // was spare, always 0
+    size_t placeSize = (header.placeRadius > 0) ? sizeof(placeCenterStruct) : 0;
+    if (stateSize != sizeof(header) + header.machRecCnt * (sizeof(mach2kStruct) + histSize + placeSize))
+    {
+        logAt(LOG_ERROR, logOut) << "Mach record count error" << endl;
+        return 8;
+    }
+
+    /** The checksum is taken over the records in the mapping, they are then copied once into the subject **/
+    const mach2kStruct *fileRec = (const mach2kStruct *)(stateData + sizeof(header));
+    const dwellHistStruct *fileHist = (histSize > 0) ? (const dwellHistStruct *)(fileRec + header.machRecCnt) : nullptr;
+    const placeCenterStruct *filePlace = (placeSize > 0) ? (const placeCenterStruct *)(fileHist + header.machRecCnt) : nullptr;
+    if (stateChecksum(header, fileRec, fileHist, filePlace) != header.checksum)
+    {
+        logAt(LOG_ERROR, logOut) << "MACH2K state file " << stateName << " checksum error." << endl;
+        return 3;
+    }
+
+    if (param.zoomLevelStr.empty())
+    {
+        param.zoomLevelStr = header.zoomLevelStr;
+        param.durationStr = header.durationStr;
+        param.version = header.programName;
+        param.placeRadius = header.placeRadius;
+    }
+    logAt(LOG_DEBUG, logOut) << "File distance=" << header.zoomLevelStr << ", Zoom level parameter=" << param.zoomLevelStr << endl;
+    logAt(LOG_DEBUG, logOut) << "File duration=" << header.durationStr << ", Duration parameter=" << param.durationStr << endl;
+    if (param.zoomLevelStr != header.zoomLevelStr)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K file zoom level of "
+             << header.zoomLevelStr << " must equal input distance limit of " << param.zoomLevelStr << "." << endl;
+        return 4;
+    }
+    if (param.durationStr != header.durationStr)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K file time duration of "
+             << header.durationStr << "must equal input time duration of " << param.durationStr << " seconds." << endl;
+        return 5;
+    }
+    if ((uint32_t)param.placeRadius != header.placeRadius)
+    {
+        logAt(LOG_ERROR, logOut) << "Existing MACH2K file place radius of " << header.placeRadius
+             << " meters must equal --place-radius of " << param.placeRadius << " meters (0 = tiles)." << endl;
+        return 4;
+    }
+
+    subj.subject = header.subject;
+    subj.firstDateTime = header.firstDateTime;
+    subj.lastDateTime = header.lastDateTime;
+    subj.maxTraceIntervalHHMMSS = header.maxTraceIntervalHHMMSS;
+    subj.totDaysCnt = header.totDaysCnt;
+    subj.totHrsCnt = header.totHrsCnt;
+    subj.totLocsCnt = header.totLocsCnt;
+    subj.totQualDura = header.totQualDura;
+    subj.totQualDaysCnt = header.totQualDaysCnt;
+    subj.maxTraceInterval = header.maxTraceInterval;
+    subj.minTraceInterval = header.minTraceInterval;
+    subj.totTraceInterval = header.totTraceInterval;
+    subj.minXtile = header.minXtile;
+    subj.minYtile = header.minYtile;
+    subj.maxXtile = header.maxXtile;
+    subj.maxYtile = header.maxYtile;
+    subj.traceRecCnt = header.traceRecCnt;
+    subj.totQualTraceCnt = header.totQualTraceCnt;
+    subj.machRecCnt = header.machRecCnt;
+    subj.mach2kRec.assign(fileRec, fileRec + header.machRecCnt);
+    if (fileHist)
+        subj.dwellHist.assign(fileHist, fileHist + header.machRecCnt);
+    else
+        subj.dwellHist.assign(header.machRecCnt, dwellHistStruct());
+    rebuildTileIndex(subj);
+    subj.places = placeIndexStruct();
+    if (filePlace)
+    {
+        subj.places.centers.assign(filePlace, filePlace + header.machRecCnt);
+        rebuildPlaceIndex(subj.places, param.placeRadius/1000.0);
+    }
+
+    logAt(LOG_INFO, logOut) << "M2K state read: machRecCnt=" << subj.machRecCnt << ",traceRecCnt=" << subj.traceRecCnt << endl;
+
+    subj.m2kLoaded = true;
+    return 0;
+}
+
+/**
+*
+* Write the subject totals and records to the binary NNN_MACH2K.bin state file:
+* a mach2kStateStruct header followed by the mach2kStruct records and their dwellHistStruct
+* histograms. The file is replaced in one step (see writeFileAtomic()), keeping the old one as
+* NNN_MACH2K.bin.bak with keepBackup. Returns 0, or 9 if the file cannot be written.
+*
+**/
+int writeMach2kState(const string &stateName, const runParamStruct &param, const subjectStruct &subj, bool keepBackup,
+                     ostream &logOut)
+{
+    stageTimer timer(STAGE_STATE_WRITE);
+    string stateBytes;
+    buildMach2kState(param, subj, stateBytes);
+
+    int status = writeFileAtomic(stateName, stateBytes, keepBackup, logOut);
+    if (status != 0)
+        return status;
+
+    logAt(LOG_INFO, logOut) << "M2K state written: machRecCnt=" << subj.machRecCnt << endl;
+    return 0;
+}
+
+/**
+*
+* Replace fileName with bytes so that a crash leaves the old file or the new one, never part of
+* either: write fileName.tmp, flush it to the disk, then rename it over fileName and flush the
+* directory (on Windows there is no directory to flush, the rename is left to the file system).
+* With keepBackup the old file is kept as fileName.bak, a hard link made just before the rename
+* (or the old file renamed where hard links are not supported). No shell or child process is
+* used. Returns 0, or 9 if the file cannot be written.
+*
+**/
+int writeFileAtomic(const string &fileName, const string &bytes, bool keepBackup, ostream &logOut)
+{
+    string tempName = fileName + ".tmp";
+    error_code ec;
+
+#ifndef _WIN32
+    int fd = open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = (fd >= 0);
+    for (size_t done = 0; written && (done < bytes.size()); )
+    {
+        ssize_t writeCnt = write(fd, bytes.data() + done, bytes.size() - done);
+        if ((writeCnt < 0) && (errno == EINTR))
+            continue;
+        written = (writeCnt > 0);
+        if (written)
+            done += writeCnt;
+    }
+    written = written && (fsync(fd) == 0);
+    if ((fd >= 0) && (close(fd) != 0))
+        written = false;
+#else
+    /** _commit() is FlushFileBuffers(), the Windows fsync() **/
+    int fd = _open(tempName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+    bool written = (fd >= 0);
+    for (size_t done = 0; written && (done < bytes.size()); )
+    {
+        int writeCnt = _write(fd, bytes.data() + done, (unsigned)min<size_t>(bytes.size() - done, 1 << 30));
+        written = (writeCnt > 0);
+        if (written)
+            done += writeCnt;
+    }
+    written = written && (_commit(fd) == 0);
+    if ((fd >= 0) && (_close(fd) != 0))
+        written = false;
+#endif
+    if (!written)
+    {
+        logAt(LOG_ERROR, logOut) << "Error creating and opening output file " << tempName << endl;
+        filesystem::remove(tempName, ec);
+        return 9;
+    }
+
+    if (keepBackup && filesystem::exists(fileName, ec))
+    {
+        string backupName = fileName + ".bak";
+        filesystem::remove(backupName, ec);
+        filesystem::create_hard_link(fileName, backupName, ec);
+        if (ec)
+            filesystem::rename(fileName, backupName, ec);
+    }
+
+    filesystem::rename(tempName, fileName, ec);
+    if (ec)
+    {
+        logAt(LOG_ERROR, logOut) << "Error replacing output file " << fileName << ": " << ec.message() << endl;
+        filesystem::remove(tempName, ec);
+        return 9;
+    }
+
+#ifndef _WIN32
+    /** The rename is only on the disk once the directory is **/
+    string dirName = filesystem::path(fileName).parent_path().string();
+    int dirFd = open(dirName.empty() ? "." : dirName.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd >= 0)
+    {
+        fsync(dirFd);
+        close(dirFd);
+    }
+#endif
+    return 0;
+}
+
+/**
+*
+* The binary state file contents of the subject totals and records (see writeMach2kState())
+*
+**/
+void buildMach2kState(const runParamStruct &param, const subjectStruct &subj, string &stateBytes)
+{
+    mach2kStateStruct header;
+    memset(&header, 0, sizeof(header));     // no stray bytes in the checksum
+
+    memcpy(header.magic, M2K_STATE_MAGIC, sizeof(header.magic));
+    header.version = M2K_STATE_VERSION;
+    header.recSize = sizeof(mach2kStruct);
+    snprintf(header.zoomLevelStr, sizeof(header.zoomLevelStr), "%s", param.zoomLevelStr.c_str());
+    snprintf(header.durationStr, sizeof(header.durationStr), "%s", param.durationStr.c_str());
+    snprintf(header.programName, sizeof(header.programName), "%s", param.version.c_str());
+    snprintf(header.subject, sizeof(header.subject), "%s", subj.subject.c_str());
+    snprintf(header.firstDateTime, sizeof(header.firstDateTime), "%s", subj.firstDateTime.c_str());
+    snprintf(header.lastDateTime, sizeof(header.lastDateTime), "%s", subj.lastDateTime.c_str());
+    snprintf(header.maxTraceIntervalHHMMSS, sizeof(header.maxTraceIntervalHHMMSS), "%s", subj.maxTraceIntervalHHMMSS.c_str());
+    header.totDaysCnt = subj.totDaysCnt;
+    header.totHrsCnt = subj.totHrsCnt;
+    header.totLocsCnt = subj.totLocsCnt;
+    header.totQualDura = subj.totQualDura;
+    header.totQualDaysCnt = subj.totQualDaysCnt;
+    header.maxTraceInterval = subj.maxTraceInterval;
+    header.minTraceInterval = subj.minTraceInterval;
+    header.totTraceInterval = subj.totTraceInterval;
+    header.minXtile = subj.minXtile;
+    header.minYtile = subj.minYtile;
+    header.maxXtile = subj.maxXtile;
+    header.maxYtile = subj.maxYtile;
+    header.traceRecCnt = subj.traceRecCnt;
+    header.totQualTraceCnt = subj.totQualTraceCnt;
+    header.machRecCnt = subj.machRecCnt;
+    header.placeRadius = param.placeRadius;
+    const placeCenterStruct *placeCenters = (param.placeRadius > 0) ? subj.places.centers.data() : nullptr;
+    header.checksum = stateChecksum(header, subj.mach2kRec.data(), subj.dwellHist.data(), placeCenters);
+
+    stateBytes.assign((const char *)&header, sizeof(header));
+    stateBytes.append((const char *)subj.mach2kRec.data(), subj.machRecCnt * sizeof(mach2kStruct));
+    stateBytes.append((const char *)subj.dwellHist.data(), subj.machRecCnt * sizeof(dwellHistStruct));
+    if (placeCenters)
+        stateBytes.append((const char *)placeCenters, subj.machRecCnt * sizeof(placeCenterStruct));
+}
+
+/**
+*
+* FNV-1a hash of a state file header (taken with checksum = 0), its header.machRecCnt records,
+* their histograms (none in a version 1 file) and their place centers (only with a placeRadius)
+*
+**/
+uint64_t stateChecksum(const mach2kStateStruct &header, const mach2kStruct mach2kRec[], const dwellHistStruct dwellHist[],
+                       const placeCenterStruct placeCenters[])
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto addBytes = [&hash](const void *bytes, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= ((const unsigned char *)bytes)[i];
+            hash *= 0x100000001B3ULL;
+        }
+    };
+
+    mach2kStateStruct unsummed = header;
+    unsummed.checksum = 0;
+    addBytes(&unsummed, sizeof(unsummed));
+    addBytes(mach2kRec, header.machRecCnt * sizeof(mach2kStruct));
+    if (dwellHist)
+        addBytes(dwellHist, header.machRecCnt * sizeof(dwellHistStruct));
+    if (placeCenters)
+        addBytes(placeCenters, header.machRecCnt * sizeof(placeCenterStruct));
+    return hash;
+}
+
+/**
+*
+* -export-csv: write a binary state file in the MACH2K.txt layout. Returns 0, 2 if the
+* state file cannot be opened, or the readMach2kState()/writeMach2kFile() exit code.
+*
+**/
+int exportMach2kFile(const string &stateName, const string &m2kName, const trustModelStruct &trust)
+{
+    runParamStruct param;                           // empty zoom/duration: taken from the state file
+    param.trust = trust;
+    unique_ptr<subjectStruct> subj(new subjectStruct);
+
+    int status = readMach2kState(stateName, param, *subj, cout);
+    if (status != 0)
+        return status;
+    if (!subj->m2kLoaded)
+    {
+        cout << "Cannot open input file " << stateName << endl;
+        return 2;
+    }
+
+    status = writeMach2kFile(m2kName, param, *subj, cout);
+    if (status == 0)
+        cout << "Exported " << stateName << " to " << m2kName << ", " << subj->machRecCnt << " locations" << endl;
+    return status;
+}
+
+/**
+*
+* Next value of the synthetic trace generator's random sequence (splitmix64). The sequence
+* depends only on the seed, so the same settings write the same .plt files on any platform.
+*
+**/
+uint64_t synthRand(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/** Uniform random value in [0,1) from synthRand() **/
+static inline double synthUniform(uint64_t &state)
+{
+    return (synthRand(state) >> 11) * (1.0/9007199254740992.0);
+}
+
+/** Days from 1970-01-01 to a civil date (proleptic Gregorian) **/
+static int64_t daysFromCivil(int y, int m, int d)
+{
+    y -= (m <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era*400;
+    int64_t doy = (153*(m + (m > 2 ? -3 : 9)) + 2)/5 + d - 1;
+    int64_t doe = yoe*365 + yoe/4 - yoe/100 + doy;
+    return era*146097 + doe - 719468;
+}
+
+/** Civil date, packed as YYYYMMDD, from days since 1970-01-01 **/
+static uint32_t civilFromDays(int64_t z)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era*146097;
+    int64_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    int64_t doy = doe - (365*yoe + yoe/4 - yoe/100);
+    int64_t mp = (5*doy + 2)/153;
+    int64_t d = doy - (153*mp + 2)/5 + 1;
+    int64_t m = mp + (mp < 10 ? 3 : -9);
+    return (uint32_t)((yoe + era*400 + (m <= 2))*10000 + m*100 + d);
+}
+
+/**
+*
+* Write synth.daysCnt synthetic GeoLife-style daily trace files to dirName, in the six header
+* record .plt layout read by openTraceFile(). Each day the subject starts at a random place,
+* stays there synth.dwellMinMins to synth.dwellMaxMins minutes with GPS jitter, then travels
+* in a straight line to another place at synth.speedMps, until the end of the day. A trace
+* record is written every synth.sampleSecs seconds. The names of the files written are added
+* to traceNames. Returns 0, or 9 if a file cannot be written.
+*
+**/
+int writeSynthTraces(const string &dirName, const synthParamStruct &synth, vector<string> &traceNames)
+{
+    const double metersPerDegree = 111320.0;
+    const double lonScale = 1.0/cos(deg2rad(synth.centerLat));
+    const int64_t dayNumBase = daysFromCivil(1899, 12, 30);       // trace dayNum is days since 12/30/1899
+    const int64_t startDays = daysFromCivil(synth.startYYYYMMDD / 10000, (synth.startYYYYMMDD / 100) % 100,
+                                            synth.startYYYYMMDD % 100);
+    uint64_t randState = synth.seed;
+    vector<double> placeLat, placeLon;
+    error_code ec;
+
+    filesystem::create_directories(dirName, ec);
+
+    /** Places are scattered uniformly over a disk of radius spreadMeters around the center **/
+    for (int i = 0; i < synth.placeCnt; i++)
+    {
+        double r = synth.spreadMeters*sqrt(synthUniform(randState));
+        double theta = 2.0*M_PI*synthUniform(randState);
+        placeLat.push_back(synth.centerLat + r*sin(theta)/metersPerDegree);
+        placeLon.push_back(synth.centerLon + r*cos(theta)*lonScale/metersPerDegree);
+    }
+
+    string traceData;
+    char   traceLine[128];
+    for (int day = 0; day < synth.daysCnt; day++)
+    {
+        uint32_t YYYYMMDD = civilFromDays(startDays + day);
+        double   dayNum = (double)(startDays + day - dayNumBase);
+        int      secs = 6*3600 + (int)(synthUniform(randState)*3*3600);  // first record between 06:00 and 09:00
+        int      endSecs = 24*3600 - 1 - (int)(synthUniform(randState)*3*3600);
+        int      place = (int)(synthUniform(randState)*synth.placeCnt);
+        string   fileName;
+
+        traceData = "Geolife trajectory\r\nWGS 84\r\nAltitude is in Feet\r\nReserved 3\r\n"
+                    "0,2,255,My Track,0,0,2,8421376\r\n0\r\n";
+
+        auto writeTrace = [&](double lat, double lon)
+        {
+            int hh = secs/3600, mm = (secs/60) % 60, ss = secs % 60;
+            snprintf(traceLine, sizeof(traceLine), "%.6f,%.6f,0,%d,%.10f,%04u-%02u-%02u,%02d:%02d:%02d\r\n",
+                     lat, lon, 150 + (int)(synthUniform(randState)*50), dayNum + secs/(24.0*60.0*60.0),
+                     YYYYMMDD / 10000, (YYYYMMDD / 100) % 100, YYYYMMDD % 100, hh, mm, ss);
+            traceData += traceLine;
+            if (fileName.empty())
+            {
+                snprintf(traceLine, sizeof(traceLine), "%08u%02d%02d%02d.plt", YYYYMMDD, hh, mm, ss);
+                fileName = (filesystem::path(dirName) / traceLine).string();
+            }
+            secs += synth.sampleSecs;
+        };
+
+        while (secs <= endSecs)
+        {
+            /** Stay at the place **/
+            int dwellEnd = secs + 60*(synth.dwellMinMins + (int)(synthUniform(randState)*(synth.dwellMaxMins - synth.dwellMinMins + 1)));
+            while ((secs < dwellEnd) && (secs <= endSecs))
+                writeTrace(placeLat[place] + (synthUniform(randState) - 0.5)*2.0*synth.jitterMeters/metersPerDegree,
+                           placeLon[place] + (synthUniform(randState) - 0.5)*2.0*synth.jitterMeters*lonScale/metersPerDegree);
+
+            /** Travel to another place **/
+            int next = (synth.placeCnt > 1) ? (place + 1 + (int)(synthUniform(randState)*(synth.placeCnt - 1))) % synth.placeCnt : place;
+            double dy = (placeLat[next] - placeLat[place])*metersPerDegree;
+            double dx = (placeLon[next] - placeLon[place])*metersPerDegree/lonScale;
+            int steps = (int)(sqrt(dx*dx + dy*dy)/(synth.speedMps*synth.sampleSecs));
+            for (int step = 1; (step <= steps) && (secs <= endSecs); step++)
+                writeTrace(placeLat[place] + (placeLat[next] - placeLat[place])*step/steps,
+                           placeLon[place] + (placeLon[next] - placeLon[place])*step/steps);
+            place = next;
+        }
+
+        ofstream traceFile(fileName, ios::binary | ios::trunc);
+        if (!traceFile.write(traceData.data(), traceData.size()))
+        {
+            cout << "Cannot write synthetic trace file " << fileName << endl;
+            return 9;
+        }
+        traceNames.push_back(fileName);
+    }
+    return 0;
+}
+
+/**
+*
+* Microbenchmark each stage of a run on synthetic traces (see writeSynthTraces()): trace
+* file parsing, tile projection, dwell detection, mach2kRec merge, location sort, and the
+* MACH2K.txt and binary state file writes and reads. Each stage is repeated for at least
+* half a second and reported as items/sec and ns/item, where an item is a trace record
+* or, for the sort, write and read stages, a MACH2K record. The synthetic traces are
+* written to and removed from a scratch directory. Returns 0 or the program exit code.
+*
+**/
+int runBenchmarks(const runParamStruct &param, const synthParamStruct &synth)
+{
+    string benchDir = (filesystem::temp_directory_path() /
+                       ("mach2k_bench_" + to_string(chrono::steady_clock::now().time_since_epoch().count()))).string();
+    vector<string> traceNames;
+    ostream nullOut(nullptr);       // the stages log nothing below LOG_ERROR
+    setLogLevel(nullOut, LOG_ERROR);
+    error_code ec;
+
+    int status = writeSynthTraces(benchDir, synth, traceNames);
+    if (status != 0)
+        return status;
+    sort(traceNames.begin(), traceNames.end());
+
+    /** Traces, days and tiles shared by the stages **/
+    vector<traceStruct> traceRecs;
+    vector<size_t> dayStart;
+    traceStruct traceRec;
+    for (const string &traceName : traceNames)
+    {
+        traceFileStruct traceFile;
+        openTraceFile(traceName, traceFile);
+        dayStart.push_back(traceRecs.size());
+        while (readTraceRec(traceFile, traceRec))
+            traceRecs.push_back(traceRec);
+    }
+    dayStart.push_back(traceRecs.size());
+    size_t traceCnt = traceRecs.size();
+    vector<int> xTiles(traceCnt), yTiles(traceCnt);
+    projectTiles(traceRecs.data(), traceCnt, param.numTiles, xTiles.data(), yTiles.data());
+
+    cout << "Synthetic traces: days=" << traceNames.size() << ", traces=" << traceCnt << ", secs between traces="
+         << synth.sampleSecs << ", places=" << synth.placeCnt << ", spread meters=" << synth.spreadMeters
+         << ", seed=" << synth.seed << ", zoom level=" << param.zoomLevelStr << ", secs. in place=" << param.durationStr << endl;
+    cout << "Stage,Items,Item,Iterations,Secs,Items/Sec,ns/Item" << endl;
+
+    uint64_t sink = 0;              // results folded in so no stage is optimized away
+    auto benchStage = [&](const char *stage, const char *item, size_t itemCnt, auto &&body)
+    {
+        int    iterations = 0;
+        double secs = 0.0;
+        auto   start = chrono::steady_clock::now();
+        do
+        {
+            body();
+            iterations += 1;
+            secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        } while (secs < 0.5);
+        double itemSecs = secs/((double)iterations*max<size_t>(itemCnt, 1));
+        cout << stage << ',' << itemCnt << ',' << item << ',' << iterations << ',' << secs << ','
+             << 1.0/itemSecs << ',' << itemSecs*1e9 << endl;
+    };
+
+    benchStage("parse", "trace", traceCnt, [&]()
+    {
+        for (const string &traceName : traceNames)
+        {
+            traceFileStruct traceFile;
+            openTraceFile(traceName, traceFile);
+            while (readTraceRec(traceFile, traceRec))
+                sink += traceRec.HHMMSS;
+        }
+    });
+
+    /** The same traces decoded from a trace cache instead **/
+    string cacheName = (filesystem::path(benchDir) / "bench.m2kc").string();
+    status = writeTraceCache(traceNames, cacheName, nullOut);
+    traceCacheStruct cache;
+    if (status == 0)
+        status = openTraceCache(cacheName, cache, nullOut);
+    if (status != 0)
+        return status;
+    vector<traceStruct> cacheRecs;
+    benchStage("cache read", "trace", traceCnt, [&]()
+    {
+        for (uint32_t d = 0; d < cache.header.dayCnt; d++)
+        {
+            readCacheDay(cache, cache.days[d], cacheRecs);
+            if (!cacheRecs.empty())
+                sink += cacheRecs.back().HHMMSS;
+        }
+    });
+
+    benchStage("project", "trace", traceCnt, [&]()
+    {
+        projectTiles(traceRecs.data(), traceCnt, param.numTiles, xTiles.data(), yTiles.data());
+        sink += xTiles[traceCnt / 2];
+    });
+
+    /** Dwell detection: every day applied to a new subject, the MACH2K records included **/
+    subjectStruct daySubj;
+    benchStage("dwell", "trace", traceCnt, [&]()
+    {
+        daySubj = subjectStruct();
+        for (size_t day = 0; day + 1 < dayStart.size(); day++)
+            if (dayStart[day + 1] > dayStart[day])
+            {
+                if (day > 0)
+                    roundTripTotals(daySubj);
+                processTraceRecs(&traceRecs[dayStart[day]], &xTiles[dayStart[day]], &yTiles[dayStart[day]],
+                                 dayStart[day + 1] - dayStart[day], traceFileDateTime(traceNames[day]), param, daySubj, nullOut);
+            }
+        sink += daySubj.machRecCnt;
+    });
+
+    /** Merge: a mach2kRec lookup and update (or insert) for every trace's tile, **/
+    /** far more records than dwell detection makes, for the record stages      **/
+    subjectStruct recSubj;
+    benchStage("merge", "trace", traceCnt, [&]()
+    {
+        recSubj = daySubj;
+        recSubj.mach2kRec.clear();
+        recSubj.dwellHist.clear();
+        recSubj.machRecCnt = 0;
+        recSubj.tileIndex = tileIndexStruct();
+        for (size_t i = 0; i < traceCnt; i++)
+        {
+            uint64_t key = tileKey(xTiles[i], yTiles[i]);
+            int recIdx = findTileRec(recSubj.tileIndex, key);
+            if (recIdx == -1)
+            {
+                recIdx = recSubj.machRecCnt++;
+                recSubj.mach2kRec.emplace_back();
+                recSubj.dwellHist.emplace_back();
+                mach2kStruct &machRec = recSubj.mach2kRec.back();
+                machRec.xTile = xTiles[i];
+                machRec.yTile = yTiles[i];
+                machRec.hour = 99;
+                machRec.dow = 9;
+                machRec.firstYYYYMMDD = traceRecs[i].YYYYMMDD;
+                insertTileRec(recSubj.tileIndex, key, recIdx);
+            }
+            mach2kStruct &machRec = recSubj.mach2kRec[recIdx];
+            machRec.freq += 1;
+            machRec.dura += synth.sampleSecs/3600.0;
+            machRec.traceCnt += 1;
+            machRec.lastYYYYMMDD = traceRecs[i].YYYYMMDD;
+        }
+        sink += recSubj.machRecCnt;
+    });
+    for (mach2kStruct &machRec : recSubj.mach2kRec)
+        machRec.dura = roundDuraHours(machRec.dura);
+    size_t recCnt = recSubj.machRecCnt;
+
+    benchStage("sort", "record", recCnt, [&]()
+    {
+        sink += sortLocations(recSubj.mach2kRec.data(), recSubj.machRecCnt)[0];
+    });
+
+    string m2kName = (filesystem::path(benchDir) / "bench_MACH2K.txt").string();
+    string stateName = (filesystem::path(benchDir) / "bench_MACH2K.bin").string();
+    benchStage("write M2K", "record", recCnt, [&]()
+    {
+        if (writeMach2kFile(m2kName, param, recSubj, nullOut) != 0)
+            status = 9;
+    });
+    benchStage("read M2K", "record", recCnt, [&]()
+    {
+        subjectStruct readSubj;
+        if (readMach2kFile(m2kName, param, readSubj, nullOut) != 0)
+            status = 8;
+        sink += readSubj.machRecCnt;
+    });
+    benchStage("write state", "record", recCnt, [&]()
+    {
+        if (writeMach2kState(stateName, param, recSubj, false, nullOut) != 0)
+            status = 9;
+    });
+    benchStage("read state", "record", recCnt, [&]()
+    {
+        runParamStruct readParam = param;
+        subjectStruct readSubj;
+        if (readMach2kState(stateName, readParam, readSubj, nullOut) != 0)
+            status = 8;
+        sink += readSubj.machRecCnt;
+    });
+
+    filesystem::remove_all(benchDir, ec);
+    cout << "Benchmark done, status=" << status << ", checksum=" << sink << endl;
+    return status;
+}
+
+/**
+*
+* Trace cache time of a trace record: days since 1970-01-01 * 86401 + seconds of the day,
+* which keeps a 23:59:60 leap second apart from the next day's 00:00:00
+*
+**/
+static inline int64_t cacheTime(const traceStruct &traceRec)
+{
+    int64_t days = daysFromCivil(traceRec.YYYYMMDD / 10000, (traceRec.YYYYMMDD / 100) % 100, traceRec.YYYYMMDD % 100);
+    int64_t secs = (traceRec.HHMMSS / 10000)*3600 + ((traceRec.HHMMSS / 100) % 100)*60 + traceRec.HHMMSS % 100;
+    return days*CACHE_DAY_SECS + secs;
+}
+
+/** dayNum * 10^10 expected from a trace cache time, the cache keeps only the difference from it **/
+static inline int64_t cacheDayNumScaled(int64_t days, int64_t secs)
+{
+    const int64_t dayNumBase = daysFromCivil(1899, 12, 30);       // trace dayNum is days since 12/30/1899
+    return llround(((double)(days - dayNumBase) + secs/(24.0*60.0*60.0)) * 1e10);
+}
+
+static inline void putVarint(string &out, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);     // small negatives are small too
+    while (zigzag >= 0x80)
+    {
+        out += (char)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    out += (char)zigzag;
+}
+
+static inline bool getVarint(const char *&next, const char *end, int64_t &value)
+{
+    uint64_t zigzag = 0;
+    for (int shift = 0; (next < end) && (shift < 64); shift += 7)
+    {
+        uint8_t byte = (uint8_t)*next++;
+        zigzag |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+*
+* -make-cache: read the .plt files once, in date/time order, into a binary trace cache that
+* later runs read instead (see readCacheDay()). Each file's records up to its first date
+* change are kept, with its bad record counts. Records are stored in blocks of up to
+* CACHE_BLOCK_RECS, a day per block or more, column by column: cache time (see cacheTime()),
+* latitude and longitude in microdegrees, each as the difference from the record before,
+* then dayNum as its difference from the one the time gives. Every value is a zigzag varint,
+* mostly 1 or 2 bytes, so the altitude, the "0" field and the text dates and times are gone.
+* Latitudes, longitudes and dayNums with more than 6 (10 for dayNum) decimals are rounded and
+* counted. The cache is replaced in one step (see writeFileAtomic()). Returns 0, 3 if a
+* record's date or time cannot be cached or read back, 9 if the cache cannot be written, or
+* 10 if there are no trace files.
+*
+**/
+int writeTraceCache(vector<string> traceNames, const string &cacheName, ostream &logOut)
+{
+    stable_sort(traceNames.begin(), traceNames.end(),
+                [](const string &a, const string &b) { return traceFileDateTime(a) < traceFileDateTime(b); });
+    if (traceNames.empty())
+    {
+        logAt(LOG_ERROR, logOut) << "No trace files for " << cacheName << endl;
+        return 10;
+    }
+
+    vector<traceCacheDayStruct> days;
+    vector<traceCacheBlockStruct> blocks;
+    string blockData;
+    vector<traceStruct> traceRecs;
+    traceStruct traceRec;
+    uintmax_t traceBytes = 0;
+    uint64_t traceRecCnt = 0, roundedCnt = 0;
+    error_code ec;
+
+    for (const string &traceName : traceNames)
+    {
+        traceFileStruct traceFile;
+        if (!openTraceFile(traceName, traceFile))
+        {
+            logAt(LOG_ERROR, logOut) << "Cannot open input file" << traceName << ", not cached" << endl;
+            continue;
+        }
+        traceBytes += filesystem::file_size(traceName, ec);
+        traceRecs.clear();
+        while (readTraceRec(traceFile, traceRec))
+        {
+            if (!traceRecs.empty() && (traceRec.YYYYMMDD != traceRecs[0].YYYYMMDD))
+                break;              // the same records processTraceFile() uses
+            traceRecs.push_back(traceRec);
+        }
+
+        traceCacheDayStruct day;
+        memset(&day, 0, sizeof(day));
+        snprintf(day.fileNameDateTime, sizeof(day.fileNameDateTime), "%s", traceFileDateTime(traceName).c_str());
+        day.firstBlock = blocks.size();
+        day.traceRecCnt = traceRecs.size();
+        day.badRecCnt = traceFile.badRecCnt;
+        day.firstBadLineNum = traceFile.firstBadLineNum;
+
+        for (size_t first = 0; first < traceRecs.size(); first += CACHE_BLOCK_RECS)
+        {
+            size_t last = min(first + CACHE_BLOCK_RECS, traceRecs.size());
+            traceCacheBlockStruct block;
+            block.offset = blockData.size();
+            block.traceRecCnt = last - first;
+
+            int64_t prev = 0;
+            for (size_t i = first; i < last; i++)
+            {
+                int64_t time = cacheTime(traceRecs[i]);
+                putVarint(blockData, time - prev);
+                prev = time;
+            }
+            prev = 0;
+            for (size_t i = first; i < last; i++)
+            {
+                int64_t microDeg = llround(traceRecs[i].latitude * 1e6);
+                putVarint(blockData, microDeg - prev);
+                prev = microDeg;
+            }
+            prev = 0;
+            for (size_t i = first; i < last; i++)
+            {
+                int64_t microDeg = llround(traceRecs[i].longitude * 1e6);
+                putVarint(blockData, microDeg - prev);
+                prev = microDeg;
+            }
+            for (size_t i = first; i < last; i++)
+            {
+                int64_t time = cacheTime(traceRecs[i]);
+                int64_t days = time / CACHE_DAY_SECS;
+                putVarint(blockData, llround(traceRecs[i].dayNum * 1e10) - cacheDayNumScaled(days, time - days*CACHE_DAY_SECS));
+            }
+            block.bytes = blockData.size() - block.offset;
+            blocks.push_back(block);
+        }
+        day.blockCnt = blocks.size() - day.firstBlock;
+        days.push_back(day);
+        traceRecCnt += traceRecs.size();
+
+        /** Read the day back: the dates and times must be the same, the rest may be rounded **/
+        traceCacheStruct check;
+        check.blocks = blocks.data();
+        check.blockData = blockData.data();
+        check.header.blockCnt = blocks.size();
+        check.header.dataBytes = blockData.size();
+        vector<traceStruct> checkRecs;
+        if (!readCacheDay(check, day, checkRecs))
+        {
+            logAt(LOG_ERROR, logOut) << "Cannot read back the cached records of " << traceName << endl;
+            return 3;
+        }
+        for (size_t i = 0; i < traceRecs.size(); i++)
+        {
+            if ((checkRecs[i].YYYYMMDD != traceRecs[i].YYYYMMDD) || (checkRecs[i].HHMMSS != traceRecs[i].HHMMSS))
+            {
+                logAt(LOG_ERROR, logOut) << "Cannot cache the date/time " << formatTraceDate(traceRecs[i].YYYYMMDD) << ' '
+                                         << formatTraceTime(traceRecs[i].HHMMSS) << " in " << traceName << endl;
+                return 3;
+            }
+            if ((checkRecs[i].latitude != traceRecs[i].latitude) || (checkRecs[i].longitude != traceRecs[i].longitude) ||
+                (checkRecs[i].dayNum != traceRecs[i].dayNum))
+                roundedCnt += 1;
+        }
+    }
+
+    traceCacheHeaderStruct header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, M2K_CACHE_MAGIC, sizeof(header.magic));
+    header.dayCnt = days.size();
+    header.blockCnt = blocks.size();
+    header.traceRecCnt = traceRecCnt;
+    header.dataBytes = blockData.size();
+
+    string cacheBytes((const char *)&header, sizeof(header));
+    cacheBytes.append((const char *)days.data(), days.size() * sizeof(traceCacheDayStruct));
+    cacheBytes.append((const char *)blocks.data(), blocks.size() * sizeof(traceCacheBlockStruct));
+    cacheBytes.append(blockData);
+    int status = writeFileAtomic(cacheName, cacheBytes, false, logOut);
+    if (status != 0)
+        return status;
+
+    logAt(LOG_INFO, logOut) << "Wrote " << cacheName << ": days=" << days.size() << ", traces=" << traceRecCnt
+                            << ", .plt bytes=" << traceBytes << ", cache bytes=" << cacheBytes.size() << ", ratio="
+                            << ((cacheBytes.size() > 0) ? (double)traceBytes/cacheBytes.size() : 0.0) << ", rounded traces=" << roundedCnt << endl;
+    return 0;
+}
+
+/**
+*
+* Map a trace cache written by writeTraceCache() and check its layout. Returns 0, 2 if it
+* cannot be opened or 3 if it is not a trace cache or is cut short.
+*
+**/
+int openTraceCache(const string &cacheName, traceCacheStruct &cache, ostream &logOut)
+{
+    stageTimer timer(STAGE_OPEN);
+    closeTraceFile(cache.file);
+    cache.name = cacheName;
+    if (!mapFile(cacheName, cache.file))
+    {
+        logAt(LOG_ERROR, logOut) << "Cannot open input file" << cacheName << endl;
+        return 2;
+    }
+
+    traceCacheHeaderStruct &header = cache.header;
+    if ((cache.file.size < sizeof(header)) || (memcmp(cache.file.data, M2K_CACHE_MAGIC, sizeof(header.magic)) != 0))
+    {
+        logAt(LOG_ERROR, logOut) << cacheName << " is not a MACH2K trace cache." << endl;
+        return 3;
+    }
+    memcpy(&header, cache.file.data, sizeof(header));
+    size_t indexBytes = header.dayCnt * sizeof(traceCacheDayStruct) + header.blockCnt * sizeof(traceCacheBlockStruct);
+    if (cache.file.size != sizeof(header) + indexBytes + header.dataBytes)
+    {
+        logAt(LOG_ERROR, logOut) << "Trace cache " << cacheName << " size does not match its header, it is cut short or damaged." << endl;
+        return 3;
+    }
+    cache.days = (const traceCacheDayStruct *)(cache.file.data + sizeof(header));
+    cache.blocks = (const traceCacheBlockStruct *)(cache.days + header.dayCnt);
+    cache.blockData = (const char *)(cache.blocks + header.blockCnt);
+    return 0;
+}
+
+/**
+*
+* Decode one day of a trace cache into traceRecs. Returns false if its blocks are damaged.
+*
+**/
+bool readCacheDay(const traceCacheStruct &cache, const traceCacheDayStruct &day, vector<traceStruct> &traceRecs)
+{
+    traceRecs.resize(day.traceRecCnt);
+    if ((day.firstBlock > cache.header.blockCnt) || (day.blockCnt > cache.header.blockCnt - day.firstBlock))
+        return false;
+
+    size_t recIdx = 0;
+    int64_t value;
+    for (uint32_t b = day.firstBlock; b < day.firstBlock + day.blockCnt; b++)
+    {
+        const traceCacheBlockStruct &block = cache.blocks[b];
+        if ((block.offset > cache.header.dataBytes) || (block.bytes > cache.header.dataBytes - block.offset) ||
+            (block.traceRecCnt > traceRecs.size() - recIdx) || (block.traceRecCnt > CACHE_BLOCK_RECS))
+            return false;
+        const char *next = cache.blockData + block.offset;
+        const char *end = next + block.bytes;
+        traceStruct *blockRecs = &traceRecs[recIdx];
+        uint32_t recCnt = block.traceRecCnt;
+        int64_t dayNumScaled[CACHE_BLOCK_RECS];     // dayNum * 10^10 the time gives, the dayNum column adds to it
+
+        /** Time column: the date only changes at midnight, so it is converted once per date **/
+        int64_t time = 0, lastDays = INT64_MIN;
+        uint32_t YYYYMMDD = 0;
+        for (uint32_t i = 0; i < recCnt; i++)
+        {
+            if (!getVarint(next, end, value))
+                return false;
+            time += value;
+            int64_t days = (time >= 0) ? time / CACHE_DAY_SECS : -((-time + CACHE_DAY_SECS - 1) / CACHE_DAY_SECS);
+            int64_t secs = time - days*CACHE_DAY_SECS;
+            if (days != lastDays)
+            {
+                YYYYMMDD = civilFromDays(days);
+                lastDays = days;
+            }
+            blockRecs[i].YYYYMMDD = YYYYMMDD;
+            blockRecs[i].HHMMSS = (secs == 24*60*60) ? 235960 : (uint32_t)((secs / 3600)*10000 + ((secs / 60) % 60)*100 + secs % 60);
+            dayNumScaled[i] = cacheDayNumScaled(days, secs);
+        }
+        int64_t microDeg = 0;
+        for (uint32_t i = 0; i < recCnt; i++)
+        {
+            if (!getVarint(next, end, value))
+                return false;
+            microDeg += value;
+            blockRecs[i].latitude = microDeg / 1e6;
+        }
+        microDeg = 0;
+        for (uint32_t i = 0; i < recCnt; i++)
+        {
+            if (!getVarint(next, end, value))
+                return false;
+            microDeg += value;
+            blockRecs[i].longitude = microDeg / 1e6;
+        }
+        for (uint32_t i = 0; i < recCnt; i++)
+        {
+            if (!getVarint(next, end, value))
+                return false;
+            blockRecs[i].dayNum = (dayNumScaled[i] + value) / 1e10;
+        }
+        recIdx += recCnt;
+    }
+    return (recIdx == traceRecs.size());
+}
+
+/**
+*
+* Process one day of a trace cache into the engine, the same as processTraceFile() does for
+* the trace file it was made from. traceRecs is scratch space reused between days. Returns 0,
+* or the program exit code if the day was not applied (3 if the cache is damaged).
+*
+**/
+int processCacheDay(const traceCacheStruct &cache, uint32_t dayIdx, mach2kEngine &engine, vector<traceStruct> &traceRecs,
+                    ostream &logOut)
+{
+    const traceCacheDayStruct &day = cache.days[dayIdx];
+    string fileNameDateTime(day.fileNameDateTime, strnlen(day.fileNameDateTime, sizeof(day.fileNameDateTime)));
+
+    logAt(LOG_INFO, logOut) << "input name=" << cache.name << ':' << fileNameDateTime << endl;
+    logAt(LOG_DEBUG, logOut) << "fileNameDateTime=" << fileNameDateTime << endl;
+
+    if (!engine.takesDay(fileNameDateTime))
+    {
+        logAt(LOG_ERROR, logOut) << "Trace file cannot be earlier or the same date as the latest processed file date." << endl;
+        return 6;
+    }
+
+    stageTimer parseTimer(STAGE_PARSE);
+    if (!readCacheDay(cache, day, traceRecs))
+    {
+        logAt(LOG_ERROR, logOut) << "Trace cache " << cache.name << " is damaged at " << fileNameDateTime << endl;
+        return 3;
+    }
+    countStat(COUNT_TRACE_FILES, 1);
+    countStat(COUNT_TRACE_RECS, traceRecs.size());
+    countStat(COUNT_BAD_RECS, day.badRecCnt);
+
+    if (traceRecs.empty())
+    {
+        logAt(LOG_ERROR, logOut) << "Input " << cache.name << ':' << fileNameDateTime << " has no trace records." << endl;
+        return 10;
+    }
+
+    if (day.badRecCnt > 0)
+    {
+        logAt(LOG_INFO, logOut) << "Skipped " << day.badRecCnt << " malformed trace records in " << cache.name << ':'
+             << fileNameDateTime << ", first at line " << day.firstBadLineNum << endl;
+    }
+
+    return engine.ingestDay(traceRecs.data(), traceRecs.size(), fileNameDateTime);
+}
+
+/**
+*
+* -make-visits: read the .plt files (or the days of one trace cache) once, in date/time order,
+* into a visit log of each day's runs at param's zoom level (see compactRuns()) that later runs
+* read instead (see readVisitDay()). Each file's records up to its first date change are used,
+* the same as processTraceFile(). A day keeps its trace interval totals, runs and their spans;
+* none of it depends on the secs. in place. Returns 0, 2 or 3 if the trace cache cannot be
+* opened or read, 9 if the visit log cannot be written, or 10 if there are no trace files.
+*
+**/
+int writeVisitLog(vector<string> traceNames, const string &visitName, const runParamStruct &param, ostream &logOut)
+{
+    stable_sort(traceNames.begin(), traceNames.end(),
+                [](const string &a, const string &b) { return traceFileDateTime(a) < traceFileDateTime(b); });
+    if (traceNames.empty())
+    {
+        logAt(LOG_ERROR, logOut) << "No trace files for " << visitName << endl;
+        return 10;
+    }
+
+    vector<visitDayStruct> days;
+    vector<traceRunStruct> runs;
+    vector<pair<double, double>> spans;
+    vector<traceStruct> traceRecs;
+    vector<int> xTiles, yTiles;
+    dayStaysStruct dayStays;
+    traceStruct traceRec;
+    uintmax_t traceBytes = 0;
+    uint64_t traceRecCnt = 0;
+    error_code ec;
+
+    /** One day: its records projected and collapsed into runs, which are appended with their spans **/
+    auto addDay = [&](const string &fileNameDateTime, uint32_t badRecCnt, uint32_t firstBadLineNum)
+    {
+        visitDayStruct day;
+        memset(&day, 0, sizeof(day));
+        snprintf(day.fileNameDateTime, sizeof(day.fileNameDateTime), "%s", fileNameDateTime.c_str());
+        day.pointCnt = traceRecs.size();
+        day.badRecCnt = badRecCnt;
+        day.firstBadLineNum = firstBadLineNum;
+        day.firstRun = runs.size();
+        day.firstSpan = spans.size();
+        if (!traceRecs.empty())
+        {
+            xTiles.resize(traceRecs.size());
+            yTiles.resize(traceRecs.size());
+            projectTiles(traceRecs.data(), traceRecs.size(), param.numTiles, xTiles.data(), yTiles.data());
+            compactRuns(traceRecs.data(), xTiles.data(), yTiles.data(), traceRecs.size(), param.requiredTraceInterval, dayStays);
+            day.totHrs = dayStays.totHrs;
+            day.totTraceInterval = dayStays.totTraceInterval;
+            day.maxTraceInterval = dayStays.maxTraceInterval;
+            snprintf(day.maxTraceIntervalHHMMSS, sizeof(day.maxTraceIntervalHHMMSS), "%s", dayStays.maxTraceIntervalHHMMSS.c_str());
+            day.minTraceInterval = dayStays.minTraceInterval;
+            day.traceRecCnt = dayStays.traceRecCnt;
+            runs.insert(runs.end(), dayStays.runs.begin(), dayStays.runs.end());
+            spans.insert(spans.end(), dayStays.spans.begin(), dayStays.spans.end());
+        }
+        day.runCnt = runs.size() - day.firstRun;
+        day.spanCnt = spans.size() - day.firstSpan;
+        days.push_back(day);
+        traceRecCnt += traceRecs.size();
+    };
+
+    for (const string &traceName : traceNames)
+    {
+        if (filesystem::path(traceName).extension() == ".m2kc")
+        {
+            traceCacheStruct cache;
+            int status = openTraceCache(traceName, cache, logOut);
+            if (status != 0)
+                return status;
+            traceBytes += filesystem::file_size(traceName, ec);
+            for (uint32_t d = 0; d < cache.header.dayCnt; d++)
+            {
+                const traceCacheDayStruct &cacheDay = cache.days[d];
+                string fileNameDateTime(cacheDay.fileNameDateTime, strnlen(cacheDay.fileNameDateTime, sizeof(cacheDay.fileNameDateTime)));
+                if (!readCacheDay(cache, cacheDay, traceRecs))
+                {
+                    logAt(LOG_ERROR, logOut) << "Trace cache " << traceName << " is damaged at " << fileNameDateTime << endl;
+                    return 3;
+                }
+                addDay(fileNameDateTime, cacheDay.badRecCnt, cacheDay.firstBadLineNum);
+            }
+            continue;
+        }
+
+        traceFileStruct traceFile;
+        if (!openTraceFile(traceName, traceFile))
+        {
+            logAt(LOG_ERROR, logOut) << "Cannot open input file" << traceName << ", not logged" << endl;
+            continue;
+        }
+        traceBytes += filesystem::file_size(traceName, ec);
+        traceRecs.clear();
+        while (readTraceRec(traceFile, traceRec))
+        {
+            if (!traceRecs.empty() && (traceRec.YYYYMMDD != traceRecs[0].YYYYMMDD))
+                break;              // the same records processTraceFile() uses
+            traceRecs.push_back(traceRec);
+        }
+        addDay(traceFileDateTime(traceName), traceFile.badRecCnt, traceFile.firstBadLineNum);
+    }
+
+    visitLogHeaderStruct header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, M2K_VISIT_MAGIC, sizeof(header.magic));
+    header.version = M2K_VISIT_VERSION;
+    header.dayCnt = days.size();
+    header.zoomLevel = param.zoomLevel;
+    header.requiredTraceInterval = param.requiredTraceInterval;
+    header.runCnt = runs.size();
+    header.spanCnt = spans.size();
+    header.traceRecCnt = traceRecCnt;
+
+    string visitBytes((const char *)&header, sizeof(header));
+    visitBytes.append((const char *)days.data(), days.size() * sizeof(visitDayStruct));
+    visitBytes.append((const char *)runs.data(), runs.size() * sizeof(traceRunStruct));
+    visitBytes.append((const char *)spans.data(), spans.size() * sizeof(pair<double, double>));
+    header.checksum = partialChecksum(visitBytes);
+    memcpy(&visitBytes[0], &header, sizeof(header));
+    int status = writeFileAtomic(visitName, visitBytes, false, logOut);
+    if (status != 0)
+        return status;
+
+    logAt(LOG_INFO, logOut) << "Wrote " << visitName << ": days=" << days.size() << ", traces=" << traceRecCnt << ", runs="
+                            << runs.size() << ", input bytes=" << traceBytes << ", visit log bytes=" << visitBytes.size()
+                            << ", ratio=" << ((visitBytes.size() > 0) ? (double)traceBytes/visitBytes.size() : 0.0) << endl;
+    return 0;
+}
+
+/**
+*
+* Read a visit log written by writeVisitLog() and check its layout and checksum. Returns 0, 2
+* if it cannot be opened or 3 if it is not a visit log of this version or is damaged.
+*
+**/
+int openVisitLog(const string &visitName, visitLogStruct &visits, ostream &logOut)
+{
+    stageTimer timer(STAGE_OPEN);
+    traceFileStruct visitFile;
+    visits.name = visitName;
+    if (!mapFile(visitName, visitFile))
+    {
+        logAt(LOG_ERROR, logOut) << "Cannot open input file" << visitName << endl;
+        return 2;
+    }
+
+    visitLogHeaderStruct &header = visits.header;
+    if ((visitFile.size < sizeof(header)) || (memcmp(visitFile.data, M2K_VISIT_MAGIC, sizeof(header.magic)) != 0))
+    {
+        logAt(LOG_ERROR, logOut) << visitName << " is not a MACH2K visit log." << endl;
+        return 3;
+    }
+    memcpy(&header, visitFile.data, sizeof(header));
+    if (header.version != M2K_VISIT_VERSION)
+    {
+        logAt(LOG_ERROR, logOut) << "Visit log " << visitName << " is version " << header.version << ", this program reads version "
+                                 << M2K_VISIT_VERSION << ". Make it again with -make-visits." << endl;
+        return 3;
+    }
+    visits.bytes.assign(visitFile.data, visitFile.size);
+    if ((visits.bytes.size() != sizeof(header) + header.dayCnt * sizeof(visitDayStruct) + header.runCnt * sizeof(traceRunStruct) +
+                                header.spanCnt * sizeof(pair<double, double>)) ||
+        (partialChecksum(visits.bytes) != header.checksum))
+    {
+        logAt(LOG_ERROR, logOut) << "Visit log " << visitName << " does not match its header or checksum, it is cut short or damaged." << endl;
+        return 3;
+    }
+    visits.days = (const visitDayStruct *)(visits.bytes.data() + sizeof(header));
+    visits.runs = (const traceRunStruct *)(visits.days + header.dayCnt);
+    visits.spans = (const pair<double, double> *)(visits.runs + header.runCnt);
+    return 0;
+}
+
+/**
+*
+* One day of a visit log as the stays findStays() finds in the trace file it was made from.
+* Returns false if its runs or spans are not in the log.
+*
+**/
+bool readVisitDay(const visitLogStruct &visits, const visitDayStruct &visitDay, dayStaysStruct &day)
+{
+    const visitLogHeaderStruct &header = visits.header;
+    if ((visitDay.firstRun > header.runCnt) || (visitDay.runCnt > header.runCnt - visitDay.firstRun) ||
+        (visitDay.firstSpan > header.spanCnt) || (visitDay.spanCnt > header.spanCnt - visitDay.firstSpan) ||
+        ((visitDay.runCnt == 0) != (visitDay.pointCnt == 0)))
+        return false;
+
+    day.runs.assign(visits.runs + visitDay.firstRun, visits.runs + visitDay.firstRun + visitDay.runCnt);
+    day.spans.assign(visits.spans + visitDay.firstSpan, visits.spans + visitDay.firstSpan + visitDay.spanCnt);
+    uint64_t spanCnt = 0;
+    for (const traceRunStruct &run : day.runs)
+        spanCnt += run.spanCnt;
+    if (spanCnt != visitDay.spanCnt)
+        return false;
+
+    day.totHrs = visitDay.totHrs;
+    day.totTraceInterval = visitDay.totTraceInterval;
+    day.maxTraceInterval = visitDay.maxTraceInterval;
+    day.maxTraceIntervalHHMMSS.assign(visitDay.maxTraceIntervalHHMMSS,
+                                      strnlen(visitDay.maxTraceIntervalHHMMSS, sizeof(visitDay.maxTraceIntervalHHMMSS)));
+    day.minTraceInterval = visitDay.minTraceInterval;
+    day.traceRecCnt = visitDay.traceRecCnt;
+    day.locChanges = (visitDay.runCnt > 0) ? visitDay.runCnt - 1 : 0;
+    day.singleRec = (visitDay.pointCnt == 1);
+    if (!day.runs.empty())
+        runStays(day);
+    return true;
+}
+
+/**
+*
+* Process one day of a visit log into the engine, the same as processTraceFile() does for the
+* trace file it was made from. day is scratch space reused between days. Returns 0, or the
+* program exit code if the day was not applied (3 if the visit log is damaged).
+*
+**/
+int processVisitDay(const visitLogStruct &visits, uint32_t dayIdx, mach2kEngine &engine, dayStaysStruct &day, ostream &logOut)
+{
+    const visitDayStruct &visitDay = visits.days[dayIdx];
+    string fileNameDateTime(visitDay.fileNameDateTime, strnlen(visitDay.fileNameDateTime, sizeof(visitDay.fileNameDateTime)));
+
+    logAt(LOG_INFO, logOut) << "input name=" << visits.name << ':' << fileNameDateTime << endl;
+    logAt(LOG_DEBUG, logOut) << "fileNameDateTime=" << fileNameDateTime << endl;
+
+    if (!engine.takesDay(fileNameDateTime))
+    {
+        logAt(LOG_ERROR, logOut) << "Trace file cannot be earlier or the same date as the latest processed file date." << endl;
+        return 6;
+    }
+
+    stageTimer parseTimer(STAGE_PARSE);
+    if (!readVisitDay(visits, visitDay, day))
+    {
+        logAt(LOG_ERROR, logOut) << "Visit log " << visits.name << " is damaged at " << fileNameDateTime << endl;
+        return 3;
+    }
+    countStat(COUNT_TRACE_FILES, 1);
+    countStat(COUNT_TRACE_RECS, visitDay.pointCnt);
+    countStat(COUNT_BAD_RECS, visitDay.badRecCnt);
+    countStat(COUNT_STAYS, day.runs.size());
+
+    if (visitDay.pointCnt == 0)
+    {
+        logAt(LOG_ERROR, logOut) << "Input " << visits.name << ':' << fileNameDateTime << " has no trace records." << endl;
+        return 10;
+    }
+
+    if (visitDay.badRecCnt > 0)
+    {
+        logAt(LOG_INFO, logOut) << "Skipped " << visitDay.badRecCnt << " malformed trace records in " << visits.name << ':'
+             << fileNameDateTime << ", first at line " << visitDay.firstBadLineNum << endl;
+    }
+
+    return engine.ingestStays(day, fileNameDateTime);
+}
+
+/**
+*
+* -stream: keep every device's MACH2K state in memory and update it from GPS fixes as they
+* arrive on stdin (socketName empty) or from the clients of a Unix socket, instead of from
+* daily trace files. A fix is a "device,latitude,longitude,0,altitude,dayNum,YYYY-MM-DD,HH:MM:SS"
+* line (a .plt record after the device id) or STREAM_FIX_MARK and a binary streamFixStruct.
+* Each device's fixes are one trace file per date (see addStreamFix()). The other input lines
+* are commands, answered on a line to the input they came from:
+*   TRUST device    "TRUST device zoom/secs=trust ..." for each params entry, with the open day so far
+*   STATS           "STATS devices=... fixes=... rejected=... days=... checkpoints=..."
+*   CHECKPOINT      write the state files now, "CHECKPOINT status=..."
+* Each device's ###_MACH2K state files (see paramFileSuffix()) are read from stateDir when it is
+* first seen, and the ones with days closed since are written back every checkpointSecs (0 for
+* only at the end). stateDir is made if it does not exist. At the end of stdin, or on
+* SIGINT/SIGTERM, the open days are closed and the state files written. Returns 0, 1 if the
+* socket cannot be made, 2 if stateDir is not a directory, or the checkpoint exit code.
+*
+**/
+#ifndef _WIN32
+static volatile sig_atomic_t streamStop = 0;
+
+int runStream(const vector<runParamStruct> &params, const string &stateDir, int checkpointSecs, const string &socketName)
+{
+    streamStruct stream;
+    vector<streamConnStruct> conns;
+    vector<pollfd> pollFds;
+    int listenFd = -1;
+    int status = 0;
+
+    stream.params = params;
+    stream.stateDir = stateDir;
+
+    /** stdin mode answers on stdout, so the log goes to stderr **/
+    asyncLogBuf logBuf(socketName.empty() ? cerr.rdbuf() : cout.rdbuf());
+    ostream logOut(&logBuf);
+    setLogLevel(logOut, logLevel(cout));
+
+    /** Checked before any input is read, a missing directory would fail only at the first checkpoint **/
+    error_code ec;
+    filesystem::create_directories(stateDir, ec);
+    if (!filesystem::is_directory(stateDir, ec))
+    {
+        logAt(LOG_ERROR, logOut) << "State directory " << stateDir << " is not a directory and cannot be made" << endl;
+        return 2;
+    }
+
+    struct sigaction stopAction;
+    memset(&stopAction, 0, sizeof(stopAction));
+    stopAction.sa_handler = [](int) { streamStop = 1; };
+    sigaction(SIGINT, &stopAction, nullptr);        // no SA_RESTART, poll() returns EINTR
+    sigaction(SIGTERM, &stopAction, nullptr);
+    signal(SIGPIPE, SIG_IGN);                       // a client that went away is seen by write()
+
+    if (socketName.empty())
+        conns.push_back(streamConnStruct{0, 1, string()});
+    else
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ((socketName.size() >= sizeof(addr.sun_path)) || (listenFd < 0))
+        {
+            logAt(LOG_ERROR, logOut) << "Cannot create socket " << socketName << endl;
+            return 1;
+        }
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socketName.c_str());
+        unlink(socketName.c_str());
+        if ((::bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0) || (listen(listenFd, 16) != 0))
+        {
+            logAt(LOG_ERROR, logOut) << "Cannot listen on socket " << socketName << endl;
+            ::close(listenFd);
+            return 1;
+        }
+    }
+    logAt(LOG_INFO, logOut) << "Streaming from " << (socketName.empty() ? string("stdin") : socketName)
+                            << ", state directory " << stateDir << ", checkpoint secs=" << checkpointSecs << endl;
+
+    auto nextCheckpoint = chrono::steady_clock::now() + chrono::seconds(checkpointSecs);
+    char readBuf[65536];
+    while (!streamStop)
+    {
+        pollFds.clear();
+        if (listenFd >= 0)
+            pollFds.push_back(pollfd{listenFd, POLLIN, 0});
+        for (streamConnStruct &conn : conns)
+            pollFds.push_back(pollfd{conn.inFd, POLLIN, 0});
+
+        int timeoutMs = -1;
+        if (checkpointSecs > 0)
+            timeoutMs = max<long long>(0, chrono::duration_cast<chrono::milliseconds>(nextCheckpoint - chrono::steady_clock::now()).count());
+        if ((poll(pollFds.data(), pollFds.size(), timeoutMs) < 0) && (errno != EINTR))
+        {
+            logAt(LOG_ERROR, logOut) << "poll() failed, errno=" << errno << endl;
+            break;
+        }
+
+        if ((checkpointSecs > 0) && (chrono::steady_clock::now() >= nextCheckpoint))
+        {
+            checkpointStream(stream, false, logOut);
+            nextCheckpoint = chrono::steady_clock::now() + chrono::seconds(checkpointSecs);
+        }
+
+        size_t fdIdx = 0;
+        if (listenFd >= 0)
+        {
+            if (pollFds[fdIdx++].revents & POLLIN)
+            {
+                int clientFd = accept(listenFd, nullptr, nullptr);
+                if (clientFd >= 0)
+                    conns.push_back(streamConnStruct{clientFd, clientFd, string()});
+            }
+        }
+
+        /** Read what each input has, handle the whole fixes and lines, keep the rest for the next read **/
+        size_t polledConns = pollFds.size() - fdIdx;     // connections accepted above were not polled yet
+        for (size_t c = polledConns; c-- > 0; )
+        {
+            if (!(pollFds[fdIdx + c].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            ssize_t readCnt = read(conns[c].inFd, readBuf, sizeof(readBuf));
+            if ((readCnt < 0) && (errno == EINTR))
+                continue;
+            if (readCnt > 0)
+            {
+                conns[c].buffer.append(readBuf, readCnt);
+                handleStreamInput(stream, conns[c], logOut);
+                continue;
+            }
+
+            /** End of input: a last line without a line end is still handled **/
+            if (!conns[c].buffer.empty() && (conns[c].buffer[0] != STREAM_FIX_MARK))
+            {
+                conns[c].buffer += '\n';
+                handleStreamInput(stream, conns[c], logOut);
+            }
+            if (conns[c].inFd == 0)
+                streamStop = 1;         // end of stdin is the end of the stream
+            else
+                ::close(conns[c].inFd);
+            conns.erase(conns.begin() + c);
+        }
+    }
+
+    /** Close the open days, the same as the end of each device's last trace file, then write the state files **/
+    status = checkpointStream(stream, true, logOut);
+    for (streamConnStruct &conn : conns)
+        if (conn.inFd != 0)
+            ::close(conn.inFd);
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+        unlink(socketName.c_str());
+    }
+    logAt(LOG_INFO, logOut) << "Stream done: devices=" << stream.devices.size() << ", fixes=" << stream.fixCnt
+                            << ", rejected=" << stream.rejectCnt << ", days=" << stream.dayCnt << ", status=" << status << endl;
+    return status;
+}
+
+/**
+*
+* Handle the whole fixes and command lines at the start of conn.buffer (see runStream()) and
+* remove them, leaving a partial fix or line for the next read
+*
+**/
+void handleStreamInput(streamStruct &stream, streamConnStruct &conn, ostream &logOut)
+{
+    const string &buffer = conn.buffer;
+    size_t pos = 0;
+    traceStruct fix;
+
+    while (pos < buffer.size())
+    {
+        if (buffer[pos] == STREAM_FIX_MARK)
+        {
+            if (buffer.size() - pos < 1 + sizeof(streamFixStruct))
+                break;
+            streamFixStruct binFix;
+            memcpy(&binFix, buffer.data() + pos + 1, sizeof(binFix));
+            pos += 1 + sizeof(binFix);
+
+            fix.latitude = binFix.latitude;
+            fix.longitude = binFix.longitude;
+            fix.dayNum = binFix.dayNum;
+            fix.YYYYMMDD = binFix.YYYYMMDD;
+            fix.HHMMSS = binFix.HHMMSS;
+            if (!(fabs(fix.latitude) <= 90.0) || !(fabs(fix.longitude) <= 180.0) ||
+                !(fix.dayNum > 0.0) || !(fix.dayNum < 1000000.0) || (fix.HHMMSS > 235960))
+                stream.rejectCnt += 1;
+            else
+                addStreamFix(stream, string(binFix.device, strnlen(binFix.device, sizeof(binFix.device))), fix, logOut);
+            continue;
+        }
+
+        const char *line = buffer.data() + pos;
+        const char *eol = (const char *)memchr(line, '\n', buffer.size() - pos);
+        if (!eol)
+        {
+            if (buffer.size() - pos > 4096)     // not a fix or command, drop it
+            {
+                stream.rejectCnt += 1;
+                pos = buffer.size();
+            }
+            break;
+        }
+        const char *last = eol;
+        pos = eol + 1 - buffer.data();
+        if ((last > line) && (last[-1] == '\r'))   // Windows line ends
+            last--;
+        if (last == line)
+            continue;
+
+        /** device,.plt record **/
+        const char *comma = (const char *)memchr(line, ',', last - line);
+        if (comma)
+        {
+            if (parseTraceRec(comma + 1, last, fix))
+                addStreamFix(stream, string(line, comma), fix, logOut);
+            else
+                stream.rejectCnt += 1;
+            continue;
+        }
+
+        /** Command **/
+        string command(line, last), device;
+        size_t space = command.find(' ');
+        if (space != string::npos)
+        {
+            device = command.substr(space + 1);
+            command.erase(space);
+        }
+        ostringstream reply;
+        if ((command == "TRUST") && !device.empty())
+        {
+            reply << "TRUST " << device;
+            auto found = stream.devices.find(device);
+            if ((found == stream.devices.end()) || (found->second.status != 0))
+                reply << " unknown";
+            else
+            {
+                for (size_t p = 0; p < stream.params.size(); p++)
+                    reply << ' ' << stream.params[p].zoomLevelStr << '/' << stream.params[p].durationStr << '='
+                          << found->second.engine.trust(p);
+            }
+        }
+        else
+        if (command == "STATS")
+            reply << "STATS devices=" << stream.devices.size() << " fixes=" << stream.fixCnt << " rejected=" << stream.rejectCnt
+                  << " days=" << stream.dayCnt << " checkpoints=" << stream.checkpointCnt;
+        else
+        if (command == "CHECKPOINT")
+            reply << "CHECKPOINT status=" << checkpointStream(stream, false, logOut);
+        else
+            reply << "ERROR unknown command " << string(line, last);
+        reply << '\n';
+
+        string replyStr = reply.str();
+        for (size_t sent = 0; sent < replyStr.size(); )
+        {
+            ssize_t writeCnt = write(conn.outFd, replyStr.data() + sent, replyStr.size() - sent);
+            if ((writeCnt < 0) && (errno == EINTR))
+                continue;
+            if (writeCnt <= 0)
+                break;          // client gone, its input ends on the next read
+            sent += writeCnt;
+        }
+    }
+    conn.buffer.erase(0, pos);
+}
+
+/**
+*
+* Apply one fix of a device to its open day (see mach2kEngine::ingest()). The device's state
+* files are read when it is first seen. Each date of a device's fixes is a trace file named by
+* the date/time of its first fix: a fix of a later date ends the open day, a fix of an earlier
+* date, or of a day at or before the last date/time in the device's state, is rejected.
+*
+**/
+void addStreamFix(streamStruct &stream, const string &device, const traceStruct &fix, ostream &logOut)
+{
+    const vector<runParamStruct> &params = stream.params;
+
+    /** Device ids become file names and the state file subject **/
+    if (device.empty() || (device.size() >= sizeof(mach2kStateStruct::subject)) ||
+        (device.find_first_not_of("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_") != string::npos))
+    {
+        stream.rejectCnt += 1;
+        return;
+    }
+
+    auto found = stream.devices.find(device);
+    if (found == stream.devices.end())
+    {
+        found = stream.devices.try_emplace(device, params, device, logOut).first;
+        streamDeviceStruct &newDev = found->second;
+        for (size_t p = 0; (p < params.size()) && (newDev.status == 0); p++)
+        {
+            runParamStruct fileParam = params[p];
+            newDev.status = readMach2kState(streamStateName(stream, device, p), fileParam, newDev.engine.subject(p), logOut);
+        }
+        if (newDev.status != 0)
+        {
+            logAt(LOG_ERROR, logOut) << "Device " << device << " state not read, status=" << newDev.status << ", its fixes are rejected" << endl;
+        }
+    }
+    streamDeviceStruct &dev = found->second;
+    uint64_t daysEnded = dev.engine.daysEnded();
+    if ((dev.status != 0) || (dev.engine.ingest(fix) != 0))
+    {
+        stream.rejectCnt += 1;
+        return;
+    }
+    stream.dayCnt += dev.engine.daysEnded() - daysEnded;
+    stream.fixCnt += 1;
+}
+
+/**
+*
+* Write the state files of the devices with days closed since the last checkpoint, closing
+* the open days first if closeDays (at the end of the stream). Returns 0, or the last
+* writeMach2kState() exit code; a device that failed is written again next time.
+*
+**/
+int checkpointStream(streamStruct &stream, bool closeDays, ostream &logOut)
+{
+    int status = 0;
+    size_t written = 0;
+    for (auto &device : stream.devices)
+    {
+        streamDeviceStruct &dev = device.second;
+        if (closeDays && dev.engine.dayOpen())
+        {
+            dev.engine.endDay();
+            stream.dayCnt += 1;
+        }
+        if (dev.engine.daysEnded() == dev.checkpointDays)
+            continue;
+        bool writeOk = true;
+        for (size_t p = 0; p < stream.params.size(); p++)
+        {
+            if (!dev.engine.subject(p).m2kLoaded)
+                continue;
+            int writeStatus = writeMach2kState(streamStateName(stream, device.first, p), stream.params[p],
+                                               dev.engine.subject(p), false, logOut);
+            if (writeStatus != 0)
+            {
+                status = writeStatus;
+                writeOk = false;
+            }
+        }
+        if (writeOk)
+            dev.checkpointDays = dev.engine.daysEnded();
+        written += 1;
+    }
+    stream.checkpointCnt += 1;
+    logAt(LOG_INFO, logOut) << "Checkpoint: devices written=" << written << ", status=" << status << endl;
+    return status;
+}
+
+/**
+*
+* Path of a device's state file for params entry paramIdx in the stream's state directory
+*
+**/
+string streamStateName(const streamStruct &stream, const string &device, size_t paramIdx)
+{
+    return (filesystem::path(stream.stateDir) / (device + "_MACH2K" + paramFileSuffix(stream.params, paramIdx) + ".bin")).string();
+}
+#else
+int runStream(const vector<runParamStruct> &params, const string &stateDir, int checkpointSecs, const string &socketName)
+{
+    cout << "-stream is not available on Windows" << endl;
+    return 1;
+}
+#endif
+
+/** Pack tile coordinates into a 64-bit mach2kRec index key: x in bits 40-63, y in bits 16-39. **/
+/** Zoom 21 needs 21 bits per coordinate. The low 16 bits are left for hour and dow.           **/
+uint64_t tileKey(int xTile, int yTile)
+{
+    return ((uint64_t)(uint32_t)xTile << 40) | ((uint64_t)(uint32_t)yTile << 16);
+}
+
+/** Slot to start probing at, a Fibonacci hash of the key over a power of 2 table **/
+static inline size_t tileSlot(uint64_t key, size_t mask)
+{
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(key ^ (key >> 32)) & mask;
+}
+
+/** Return the mach2kRec index for key, or -1 if the tile has no record yet **/
+int findTileRec(const tileIndexStruct &tileIndex, uint64_t key)
+{
+    if (tileIndex.used == 0)
+        return -1;
+
+    size_t mask = tileIndex.keys.size() - 1;
+    for (size_t slot = tileSlot(key, mask); tileIndex.recIdx[slot] != -1; slot = (slot + 1) & mask)
+        if (tileIndex.keys[slot] == key)
+            return tileIndex.recIdx[slot];
+    return -1;
+}
+
+/** Add key for mach2kRec[recIdx], doubling the table (linear probing) when it would pass half full **/
+void insertTileRec(tileIndexStruct &tileIndex, uint64_t key, int recIdx)
+{
+    if ((tileIndex.used + 1) * 2 > (int)tileIndex.keys.size())
+    {
+        tileIndexStruct grown;
+        size_t capacity = tileIndex.keys.empty() ? 1024 : tileIndex.keys.size() * 2;
+        grown.keys.assign(capacity, 0);
+        grown.recIdx.assign(capacity, -1);
+        for (size_t slot = 0; slot < tileIndex.keys.size(); slot++)
+            if (tileIndex.recIdx[slot] != -1)
+                insertTileRec(grown, tileIndex.keys[slot], tileIndex.recIdx[slot]);
+        tileIndex = move(grown);
+    }
+
+    size_t mask = tileIndex.keys.size() - 1;
+    size_t slot = tileSlot(key, mask);
+    while (tileIndex.recIdx[slot] != -1)
+    {
+        if (tileIndex.keys[slot] == key)
+        {
+            tileIndex.recIdx[slot] = recIdx;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    tileIndex.keys[slot] = key;
+    tileIndex.recIdx[slot] = recIdx;
+    tileIndex.used += 1;
+}
+
+/** Re-index mach2kRec after it is loaded or sorted. The first record of a duplicated tile wins, as the linear search did. **/
+void rebuildTileIndex(subjectStruct &subj)
+{
+    tileIndexStruct &tileIndex = subj.tileIndex;
+    fill(tileIndex.recIdx.begin(), tileIndex.recIdx.end(), -1);
+    tileIndex.used = 0;
+
+    for (int i = 0; i < subj.machRecCnt; i++)
+    {
+        uint64_t key = tileKey(subj.mach2kRec[i].xTile, subj.mach2kRec[i].yTile);
+        if (findTileRec(tileIndex, key) == -1)
+            insertTileRec(tileIndex, key, i);
+    }
+}
+
+/**
+*
+* Grid cell key of a --place-radius place index: cell row and column packed, every value distinct
+*
+**/
+static inline uint64_t placeCell(int64_t cellX, int64_t cellY)
+{
+    return ((uint64_t)(uint32_t)cellX << 32) | (uint32_t)cellY;
+}
+
+/**
+*
+* Index of the place nearest latitude,longitude (great circle, see distanceEarth()) that is at
+* most placeRadius km from it, or -1. A place that close is at most one cell away in latitude;
+* the columns searched are widened for the latitude, to every place near the poles, and wrap
+* around at +-180 degrees longitude. Places at the same distance go to the first one.
+*
+**/
+int findPlace(const placeIndexStruct &places, double placeRadius, double latitude, double longitude)
+{
+    if (places.centers.empty())
+        return -1;
+
+    int    bestIdx = -1;
+    double bestDist = placeRadius;
+    auto nearer = [&](int placeIdx)
+    {
+        const placeCenterStruct &center = places.centers[placeIdx];
+        double dist = distanceEarth(latitude, longitude, center.latitude, center.longitude);
+        if ((dist < bestDist) || ((dist == bestDist) && ((bestIdx == -1) || (placeIdx < bestIdx))))
+        {
+            bestIdx = placeIdx;
+            bestDist = dist;
+        }
+    };
+
+    /** Longitude degrees within placeRadius, at the row nearest the pole **/
+    double cellDeg = places.cellDeg;
+    double cosLat = cos(deg2rad(min(90.0, fabs(latitude) + cellDeg)));
+    double lonRatio = sin(placeRadius/(2.0*earthRadiusKm))/max(cosLat, 1e-12);
+    double lonDeg = (lonRatio < 1.0) ? rad2deg(2.0*asin(lonRatio)) : 360.0;
+    auto column = [cellDeg](double lon) { return (int64_t)floor(lon/cellDeg); };
+    int64_t cellY = (int64_t)floor(latitude/cellDeg);
+
+    /** Column ranges to look in, split in two where the longitudes cross the antimeridian **/
+    int64_t firstX[2], lastX[2];
+    int     rangeCnt = 1;
+    if (lonDeg >= 180.0)
+    {
+        firstX[0] = column(-180.0);
+        lastX[0] = column(180.0);
+    }
+    else if (longitude - lonDeg < -180.0)
+    {
+        firstX[0] = column(-180.0);
+        lastX[0] = column(longitude + lonDeg);
+        firstX[1] = column(longitude - lonDeg + 360.0);
+        lastX[1] = column(180.0);
+        rangeCnt = 2;
+    }
+    else if (longitude + lonDeg > 180.0)
+    {
+        firstX[0] = column(longitude - lonDeg);
+        lastX[0] = column(180.0);
+        firstX[1] = column(-180.0);
+        lastX[1] = column(longitude + lonDeg - 360.0);
+        rangeCnt = 2;
+    }
+    else
+    {
+        firstX[0] = column(longitude - lonDeg);
+        lastX[0] = column(longitude + lonDeg);
+    }
+
+    int64_t columnCnt = 0;
+    for (int r = 0; r < rangeCnt; r++)
+        columnCnt += lastX[r] - firstX[r] + 1;
+
+    if (columnCnt*3 > (int64_t)places.centers.size())
+        for (int i = 0; i < (int)places.centers.size(); i++)    // fewer places than cells to look in
+            nearer(i);
+    else
+        for (int r = 0; r < rangeCnt; r++)
+            for (int64_t y = cellY - 1; y <= cellY + 1; y++)
+                for (int64_t x = firstX[r]; x <= lastX[r]; x++)
+                {
+                    auto cell = places.cells.find(placeCell(x, y));
+                    if (cell != places.cells.end())
+                        for (int placeIdx : cell->second)
+                            nearer(placeIdx);
+                }
+    return bestIdx;
+}
+
+/**
+*
+* Add a place centered at latitude,longitude to a --place-radius place index, the next index
+*
+**/
+void insertPlace(placeIndexStruct &places, double placeRadius, double latitude, double longitude)
+{
+    if (places.centers.empty())
+        places.cellDeg = rad2deg(placeRadius/earthRadiusKm);
+    places.centers.push_back({latitude, longitude});
+    int64_t cellX = (int64_t)floor(longitude/places.cellDeg), cellY = (int64_t)floor(latitude/places.cellDeg);
+    places.cells[placeCell(cellX, cellY)].push_back((int)places.centers.size() - 1);
+}
+
+/**
+*
+* Rebuild the grid of a --place-radius place index after its centers were loaded
+*
+**/
+void rebuildPlaceIndex(placeIndexStruct &places, double placeRadius)
+{
+    vector<placeCenterStruct> centers;
+    centers.swap(places.centers);
+    places.cells.clear();
+    for (const placeCenterStruct &center : centers)
+        insertPlace(places, placeRadius, center.latitude, center.longitude);
+}
+
+/**
+*
+* Round the subject's floating point totals the same way writing them to MACH2K.txt
+* and reading them back (default 6 digit precision, then stof) would, so a multi-day
+* run gives the same output as running one trace file at a time.
+*
+**/
+void roundTripTotals(subjectStruct &subj)
+{
+    auto roundTrip = [](double value)
+    {
+        ostringstream oss;
+        oss << value;
+        return (double)stof(oss.str());
+    };
+
+    subj.totDaysCnt = roundTrip(subj.totDaysCnt);
+    subj.totHrsCnt = roundTrip(subj.totHrsCnt);
+    subj.totLocsCnt = roundTrip(subj.totLocsCnt);
+    subj.totQualDura = roundTrip(subj.totQualDura);
+    subj.totQualDaysCnt = roundTrip(subj.totQualDaysCnt);
+    subj.maxTraceInterval = roundTrip(subj.maxTraceInterval*24.0*60.0*60.0)/(24.0*60.0*60.0);
+    subj.minTraceInterval = roundTrip(subj.minTraceInterval);
+    subj.totTraceInterval = roundTrip(subj.totTraceInterval*24.0*60.0*60.0)/(24.0*60.0*60.0);
+}
 
-    /** Write MACH2K records, if any, from memory and close MACH2K.txt file **/
+/**
+*
+* Log level of a stream, kept in the stream's iword so every ostream carries its own level
+* (stored as level+1, so a stream that was never set logs at LOG_INFO)
+*
+**/
+static int logLevelIndex()
+{
+    static const int index = ios_base::xalloc();
+    return index;
+}
 
-    cout << "About to write to MACH2K file, machRecCnt=" << machRecCnt << endl;
+int logLevel(ios_base &out)
+{
+    long level = out.iword(logLevelIndex());
+    return (level == 0) ? LOG_INFO : (int)level - 1;
+}
 
-    // Sort by duration in descending order
-    if (machRecCnt > 1)
-        selectionSort(mach2kRec, machRecCnt);
+void setLogLevel(ios_base &out, int level)
+{
+    out.iword(logLevelIndex()) = level + 1;
+}
 
-    if (totQualDaysCntUpdate)  // true if this input file had at least one qualifying location/duration
-        ++totQualDaysCnt;
+/**
+*
+* Parse a --log-level value: error, info, debug, trace or 0-3
+*
+**/
+bool parseLogLevel(const string &levelName, int &level)
+{
+    static const char *levelNames[] = { "error", "info", "debug", "trace" };
+    for (int i = LOG_ERROR; i <= LOG_TRACE; i++)
+        if ((levelName == levelNames[i]) || (levelName == to_string(i)))
+        {
+            level = i;
+            return true;
+        }
+    return false;
+}
 
-    if (minXtile == 999999)
-        minXtile = 0;
-    // Write file headers with summary info
-    outFileM2K << "xTile,yTile,Hour,DOW,Freq,Hours Duration,FirstDate,LastDate\n";
-    outFileM2K << "zoom level=" << argv[3] << ", seconds=" << argv[4] << ", version=" << argv[0] << "\n";
-    outFileM2K << "1st date/time,Last date/time,Tot days,Tot hrs,Tot locs,Qual locs,"
-               << "Tot qual hrs,Tot qual days,Qual hrs/Tot hrs %,Min xTile,Min yTile,Max xTile,Max yTile,"
-               << "#1 loc%,#2 loc%,#3 loc%,#4 loc%,#5 loc%,#6 loc%,Subject,"
-               << "QH/Qdays,QL/Qdays,QD/TD,QL km^2,QL bound km^2,km^2 Density,QL/TL,QH/TH,TRUST,"
-               << "Trace Cnt,Max Interval,Max Interval HHMMSS,Min Interval,Cumm. Trace Secs.,Traces/Day,Avg Interval,"
-               << "Tot Qual Trace Cnt\n";
+/**
+*
+* Get the YYYYMMDDHHMMSS date/time from a trace file name (directories removed)
+*
+**/
+string traceFileDateTime(const string &traceName)
+{
+    return filesystem::path(traceName).filename().string().substr(0,14);
+}
 
-    outFileM2K << firstDateTime << ','                  // 1st date/time
-               << fileNameDateTime << ','               // Last date/time
-               << ++totDaysCnt << ','                   // Tot days
-               << totHrsCnt << ','                      // Tot hrs
-               << totLocsCnt << ','                     // Tot locs
-               << machRecCnt << ','                     // Qual locs
-               << totQualDura << ','                    // Tot qual hrs
-               << totQualDaysCnt << ','                 // Tot qual days
-               << (totQualDura/totHrsCnt)*100.00 << ','    // Qual hrs/Tot hrs
-               << minXtile << ','                       // Min xTile
-               << minYtile << ','                       // Min yTile
-               << maxXtile << ','                       // Max xTile
-               << maxYtile << ',';                      // Max yTile
+/**
+*
+* Map a GPS trace file into memory (read it into a buffer where mmap is not available)
+* and skip past the first six daily GPS trace header records. Returns false if the
+* file cannot be opened.
+*
+**/
+bool openTraceFile(const string &traceName, traceFileStruct &traceFile)
+{
+    stageTimer timer(STAGE_OPEN);
+    if (!mapFile(traceName, traceFile))
+        return false;
+#ifndef _WIN32
+    if (traceFile.mapped)
+        madvise((void *)traceFile.data, traceFile.size, MADV_SEQUENTIAL);
+#endif
 
-    // Write the top six location durations (checking to be sure we have five records) to the header
-    for (int i=0; i<6; i++)
-        if (i >= machRecCnt)
-            outFileM2K << 0.00 << ',';
-        else
-            outFileM2K << (stof(mach2kRec[i].dura)/totQualDura)*100.00 << ','; //#1-#6 loc%
+    /** Skip past the first six daily GPS trace header records **/
+    for (int i=0; (i<6) && (traceFile.next < traceFile.end); i++)
+    {
+        const char *eol = (const char *)memchr(traceFile.next, '\n', traceFile.end - traceFile.next);
+        traceFile.next = eol ? eol + 1 : traceFile.end;
+        traceFile.lineNum += 1;
+    } // for i<6
 
-    outFileM2K << argv[2] << ',';                       // Subject
+    return true;
+}
 
-    if (totQualDaysCnt > 0)      // avoid division by zero
-        outFileM2K << totQualDura/totQualDaysCnt << ','
-                   << machRecCnt/totQualDaysCnt << ',';
-    else
-        outFileM2K << 0 << ','
-                   << 0 << ',';
+/**
+*
+* Map a whole file read only (read it into memory where mmap is not available).
+* Returns false if the file cannot be opened or is not a regular file.
+*
+**/
+bool mapFile(const string &fileName, traceFileStruct &mappedFile)
+{
+    closeTraceFile(mappedFile);
+#ifdef _WIN32
+    ifstream inFile(fileName, ios::binary);
+    if (!inFile)
+        return false;
+    mappedFile.buffer.assign(istreambuf_iterator<char>(inFile), istreambuf_iterator<char>());
+    mappedFile.data = mappedFile.buffer.data();
+    mappedFile.size = mappedFile.buffer.size();
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileStat;
+    if ((fstat(fd, &fileStat) != 0) || !S_ISREG(fileStat.st_mode))
+    {
+        ::close(fd);
+        return false;
+    }
+    mappedFile.size = fileStat.st_size;
+    if (mappedFile.size > 0)
+    {
+        void *map = mmap(nullptr, mappedFile.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        mappedFile.data = (const char *)map;
+        mappedFile.mapped = true;
+    }
+    ::close(fd);            // the mapping stays valid after the descriptor is closed
+#endif
+    mappedFile.next = mappedFile.data;
+    mappedFile.end = mappedFile.data + mappedFile.size;
+    return true;
+}
 
-    outFileM2K << totQualDaysCnt/totDaysCnt << ','
-               << machRecCnt*.219961 << ','                                             //QL km^2
-               << ((maxXtile-minXtile+1)*tileLength)*((maxYtile-minYtile+1)*tileLength) << ','      //QL bound km^2
-               << ((machRecCnt*.219961)/(((maxXtile-minXtile+1.0)*tileLength)*((maxYtile-minYtile+1.0)*tileLength))) << ',' // Density
-               << machRecCnt/totLocsCnt << ','
-               << totQualDura/totHrsCnt << ',';
+/**
+*
+* Read the next trace record from a mapped trace file. Malformed records are
+* counted and skipped, blank lines are ignored. Returns false at end of file.
+*
+**/
+bool readTraceRec(traceFileStruct &traceFile, traceStruct &traceRec)
+{
+    while (traceFile.next < traceFile.end)
+    {
+        const char *line = traceFile.next;
+        const char *eol = (const char *)memchr(line, '\n', traceFile.end - line);
+        const char *last = eol ? eol : traceFile.end;
+        traceFile.next = eol ? eol + 1 : traceFile.end;
+        traceFile.lineNum += 1;
+
+        if ((last > line) && (last[-1] == '\r'))   // Windows line ends
+            last--;
+        if (last == line)
+            continue;
+
+        if (parseTraceRec(line, last, traceRec))
+            return true;
+
+        if (traceFile.badRecCnt == 0)
+            traceFile.firstBadLineNum = traceFile.lineNum;
+        traceFile.badRecCnt += 1;
+    }
+    return false;
+}
 
-    if ((totDaysCnt > 0) &&
-        (((maxXtile-minXtile+1)*tileLength)*((maxYtile-minYtile+1)*tileLength) < 1000.0) && // Less than 1000km^2 area
-        (machRecCnt > 2))                                                       // Trust = 0 if < 3 locations
+/**
+*
+* Parse one trace record "latitude,longitude,0,altitude,dayNum,YYYY-MM-DD,HH:MM:SS"
+* between field and last without copying it. Returns false if any field is missing,
+* not a number, or out of range.
+*
+**/
+bool parseTraceRec(const char *field, const char *last, traceStruct &traceRec)
+{
+    auto number = [&](double &value)
+    {
+        from_chars_result result = from_chars(field, last, value);
+        if ((result.ec != errc()) || (result.ptr == field))
+            return false;
+        field = result.ptr;
+        return true;
+    };
+    auto separator = [&](char sep)
     {
-        /** Calculate TRUST value, equal weights for each factor for now **/
-        machTrust = .1666*((totQualDura/totQualDaysCnt)/2.49) + // divide all terms by observed avg.p + 1 standard deviation
-                    .1666*((machRecCnt/totQualDaysCnt)/.93) +
-                    .1666*((totQualDaysCnt/totDaysCnt)/.17) +
-                    .1666*((machRecCnt/totLocsCnt)/.003) +
-                    .1666*((totQualDura/totHrsCnt)/.102) +
-                    // QualLocs area in km^2 / QualLocs boundary area in km^2
-                    .1666*((machRecCnt*.219961)/(((maxXtile-minXtile+1)*tileLength)*((maxYtile-minYtile+1)*tileLength))/.40);
+        if ((field >= last) || (*field != sep))
+            return false;
+        field++;
+        return true;
+    };
+    auto skipField = [&]()          // "0" and altitude fields, not used
+    {
+        const char *comma = (const char *)memchr(field, ',', last - field);
+        if (!comma)
+            return false;
+        field = comma + 1;
+        return true;
+    };
+    auto digits = [&](int count, uint32_t &value)
+    {
+        value = 0;
+        for (int i=0; i<count; i++, field++)
+        {
+            if ((field >= last) || (*field < '0') || (*field > '9'))
+                return false;
+            value = value*10 + (*field - '0');
+        }
+        return true;
+    };
+    uint32_t year, month, day, hour, minute, second;
+
+    if (!(number(traceRec.latitude) && separator(',') &&
+          number(traceRec.longitude) && separator(',') &&
+          skipField() && skipField() &&
+          number(traceRec.dayNum) && separator(',') &&
+          digits(4, year) && separator('-') && digits(2, month) && separator('-') && digits(2, day) && separator(',') &&
+          digits(2, hour) && separator(':') && digits(2, minute) && separator(':') && digits(2, second) &&
+          (field == last)))
+        return false;
+
+    if (!(fabs(traceRec.latitude) <= 90.0) || !(fabs(traceRec.longitude) <= 180.0) ||
+        !(traceRec.dayNum > 0.0) || !(traceRec.dayNum < 1000000.0) ||
+        (month < 1) || (month > 12) || (day < 1) || (day > 31) ||
+        (hour > 23) || (minute > 59) || (second > 60))
+        return false;
+
+    traceRec.YYYYMMDD = year*10000 + month*100 + day;
+    traceRec.HHMMSS = hour*10000 + minute*100 + second;
+    return true;
+}
 
-        if (totDaysCnt < 30)
-            machTrust = machTrust * (totDaysCnt/30.0);       // Adjust trust if < 30 total days of data
-        outFileM2K << machTrust<< ',';                     // May want to check for at least 30 consecutive days?
-    }
-    else
-        outFileM2K << "0,";        // if no qualifying days yet, TRUST=0
+/**
+*
+* Unmap (or free) a trace file opened by openTraceFile
+*
+**/
+void closeTraceFile(traceFileStruct &traceFile)
+{
+#ifndef _WIN32
+    if (traceFile.mapped)
+        munmap((void *)traceFile.data, traceFile.size);
+#endif
+    traceFile.mapped = false;
+    traceFile.buffer.clear();
+    traceFile.data = traceFile.next = traceFile.end = nullptr;
+    traceFile.size = 0;
+}
 
-    /** Add Trace Cnt and max, min, total intervals (in seconds) at end of header data **/
-    cout << "Writing: traceRecCnt=" << traceRecCnt
-         << ",maxTraceInterval=" << maxTraceInterval*24.0*60.0*60.0
-         << ", maxTraceIntervalHHMMSS=" << maxTraceIntervalHHMMSS
-         << ",minTraceInterval=" << minTraceInterval
-         << ",tot Trace Intervals=" << totTraceInterval*24.0*60.0*60.0
-         << ", Traces per day=" << (traceRecCnt/totDaysCnt)
-         << ",Avg. Trace=" << (totTraceInterval*24.0*60.0*60.0)/((traceRecCnt*1.0)-totDaysCnt) << endl;
-    outFileM2K  << traceRecCnt << ','
-                << maxTraceInterval*24.0*60.0*60.0 << ','
-                << maxTraceIntervalHHMMSS << ','
-                << minTraceInterval << ','
-                << totTraceInterval*24.0*60.0*60.0 << ','
-                << traceRecCnt/totDaysCnt << ','
-                << (totTraceInterval*24.0*60.0*60.0)/((traceRecCnt*1.0)-totDaysCnt) << ','
-                << totQualTraceCnt << "\n";
-
-    cout << "Before mach2kRec(s) write, machRecCnt=" << machRecCnt << "mach2kRec[0].traceCnt=" << mach2kRec[0].traceCnt << endl;
-    /** Write data records **/
-    for (int i=0; i<machRecCnt; i++)
-        outFileM2K  << mach2kRec[i].xTile << ','
-                    << mach2kRec[i].yTile << ','
-                    << mach2kRec[i].hour << ','
-                    << mach2kRec[i].dow << ','
-//                       << mach2kRec[i].mo << ','
-                    << mach2kRec[i].freq << ','
-                    << mach2kRec[i].dura << ','
-                    << mach2kRec[i].traceCnt << ','
-                    << mach2kRec[i].firstYYYYMMDD << ','
-                    << mach2kRec[i].lastYYYYMMDD << "\n";
+/**
+*
+* Format a packed YYYYMMDD date as YYYY-MM-DD, the same as the trace file
+*
+**/
+string formatTraceDate(uint32_t YYYYMMDD)
+{
+    char dateStr[16];
+    snprintf(dateStr, sizeof(dateStr), "%04u-%02u-%02u", YYYYMMDD / 10000, (YYYYMMDD / 100) % 100, YYYYMMDD % 100);
+    return dateStr;
+}
+
+/**
+*
+* Parse one MACH2K.txt location record (the 9 comma separated fields) into machRec.
+* Dates are YYYY-MM-DD. Returns false if a field is not a number.
+*
+**/
+bool parseMach2kRec(const string recField[], mach2kStruct &machRec)
+{
+    auto parseField = [](const string &field, auto &value)
+    {
+        const char *last = field.data() + field.size();
+        if (!field.empty() && (field.back() == '\r'))  // MACH2K.txt edited on Windows
+            last -= 1;
+        from_chars_result result = from_chars(field.data(), last, value);
+        return (result.ec == errc()) && (result.ptr == last);
+    };
+    auto parseDate = [](const string &field, uint32_t &YYYYMMDD)
+    {
+        unsigned year, month, day;
+        if (sscanf(field.c_str(), "%4u-%2u-%2u", &year, &month, &day) != 3)
+            return false;
+        YYYYMMDD = year*10000 + month*100 + day;
+        return true;
+    };
+    unsigned hour, dow;
+
+    if (!parseField(recField[0], machRec.xTile) || !parseField(recField[1], machRec.yTile) ||
+        !parseField(recField[2], hour) || !parseField(recField[3], dow) ||
+        !parseField(recField[4], machRec.freq) || !parseField(recField[5], machRec.dura) ||
+        !parseField(recField[6], machRec.traceCnt) ||
+        !parseDate(recField[7], machRec.firstYYYYMMDD) || !parseDate(recField[8], machRec.lastYYYYMMDD))
+        return false;
+    machRec.hour = hour;
+    machRec.dow = dow;
+    return true;
+}
 
-    outFileM2K.close();
+/**
+*
+* Round cumulative hours to the 6 decimals MACH2K.txt holds, so a location's duration is
+* the same whether it was kept in memory between days or written and read back.
+*
+**/
+double roundDuraHours(double hours)
+{
+    char hoursStr[64];
+    to_chars_result result = to_chars(hoursStr, hoursStr + sizeof(hoursStr), hours, chars_format::fixed, 6);
+    from_chars(hoursStr, result.ptr, hours);
+    return hours;
+}
 
-    return 0;
-} // end main
+/**
+*
+* Format a packed HHMMSS time as HH:MM:SS, the same as the trace file
+*
+**/
+string formatTraceTime(uint32_t HHMMSS)
+{
+    char timeStr[16];
+    snprintf(timeStr, sizeof(timeStr), "%02u:%02u:%02u", HHMMSS / 10000, (HHMMSS / 100) % 100, HHMMSS % 100);
+    return timeStr;
+}
+
+/**
+*
+* Calculate the OpenStreetMaps xTile,yTile coordinates of one location at numTiles = 2^zoom level
+*
+**/
+void projectTile(double lat, double lon, double numTiles, int &xTile, int &yTile)
+{
+    double lat_rad = deg2rad(lat);                  // Latitude in radians
+
+    xTile = numTiles * ((lon + 180) / 360);
+    yTile = (numTiles * (1 - (log(tan(lat_rad) + 1/cos(lat_rad)) / PI)) / 2);
+}
+
+/**
+*
+* Latitude and longitude of the center of tile xTile,yTile at numTiles, the inverse of projectTile()
+*
+**/
+void tileCenter(int xTile, int yTile, double numTiles, double &lat, double &lon)
+{
+    lon = (xTile + 0.5) / numTiles * 360 - 180;
+    lat = atan(sinh(PI * (1 - 2 * (yTile + 0.5) / numTiles))) * 180 / PI;
+}
+
+#ifdef SIMD_WIDTH
+/**
+*
+* log(tan(lat_rad) + 1/cos(lat_rad)) for |lat_rad| <= 85 degrees, SIMD_WIDTH at a time.
+* Uses tan(lat_rad) + 1/cos(lat_rad) = (1+t)/(1-t) with t = tan(lat_rad/2) from sin/cos
+* Taylor polynomials (|lat_rad/2| < .75), and log(m*2^e) = e*ln2 + 2*atanh((m-1)/(m+1)) with
+* m in [sqrt(.5),sqrt(2)). Absolute error is about 1e-15, within a few ulp of the libm result.
+*
+**/
+static inline simdDouble simdMercator(simdDouble lat_rad)
+{
+    const simdDouble one = simdSet(1.0);
+    simdDouble u = simdMul(lat_rad, simdSet(0.5));
+    simdDouble v = simdMul(u, u);
+    simdDouble sinPoly = simdSet(1.0/355687428096000.0);          // sin(u)/u = sum (-v)^k/(2k+1)!, k=0-8
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(-1.0/1307674368000.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(1.0/6227020800.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(-1.0/39916800.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(1.0/362880.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(-1.0/5040.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(1.0/120.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), simdSet(-1.0/6.0));
+    sinPoly = simdAdd(simdMul(sinPoly, v), one);
+    simdDouble cosPoly = simdSet(1.0/20922789888000.0);           // cos(u) = sum (-v)^k/(2k)!, k=0-8
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(-1.0/87178291200.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(1.0/479001600.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(-1.0/3628800.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(1.0/40320.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(-1.0/720.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(1.0/24.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), simdSet(-1.0/2.0));
+    cosPoly = simdAdd(simdMul(cosPoly, v), one);
+    simdDouble sinU = simdMul(u, sinPoly);
+    simdDouble q = simdDiv(simdAdd(cosPoly, sinU), simdSub(cosPoly, sinU));      // (1+t)/(1-t)
+
+    /** log(q): split q into mantissa m and exponent e **/
+    simdDouble expo = simdSub(simdExponent(q), simdSet(4503599627370496.0 + 1023.0));   // 2^52 + bias
+    simdDouble mant = simdMantissa(q);
+    simdDouble big = simdGreater(mant, simdSet(1.4142135623730951));
+    mant = simdSelect(big, simdMul(mant, simdSet(0.5)), mant);
+    expo = simdAdd(expo, simdSelect(big, one, simdSet(0.0)));
+    simdDouble z = simdDiv(simdSub(mant, one), simdAdd(mant, one));
+    simdDouble w = simdMul(z, z);
+    simdDouble atanhPoly = simdSet(1.0/23);                       // atanh(z)/z = sum w^k/(2k+1), k=0-11
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/21));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/19));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/17));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/15));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/13));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/11));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/9));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/7));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/5));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), simdSet(1.0/3));
+    atanhPoly = simdAdd(simdMul(atanhPoly, w), one);
+    return simdAdd(simdMul(expo, simdSet(0.6931471805599453)), simdMul(simdAdd(z, z), atanhPoly));
+}
+#endif
+
+/**
+*
+* Calculate the xTile,yTile coordinates of count trace records, the same integer tiles as
+* projectTile(). The vector path is used when |latitude| <= 85 and the calculated yTile is
+* not within 1e-13*numTiles of a tile edge (where a rounding difference from libm could
+* change it); all other records are done by projectTile().
+*
+**/
+void projectTiles(const traceStruct traceRecs[], size_t count, double numTiles, int xTiles[], int yTiles[])
+{
+    stageTimer timer(STAGE_PROJECT);
+    size_t i = 0;
+#ifdef SIMD_WIDTH
+    const double edgeGuard = numTiles * 1e-13;
+    for ( ; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        /** xTile uses the same operations in the same order as projectTile(), so it is always identical **/
+        simdDouble latitude = simdGather(&traceRecs[i], latitude);
+        simdDouble longitude = simdGather(&traceRecs[i], longitude);
+        simdDouble x = simdMul(simdSet(numTiles), simdDiv(simdAdd(longitude, simdSet(180.0)), simdSet(360.0)));
+        simdDouble lat_rad = simdMul(latitude, simdSet(3.1415926/180));
+        simdDouble y = simdSub(simdSet(numTiles/2), simdMul(simdMercator(lat_rad), simdSet(numTiles/(2*PI))));
+        __m128i yTileLow = simdTruncInt(simdSub(y, simdSet(edgeGuard)));
+        __m128i yTileHigh = simdTruncInt(simdAdd(y, simdSet(edgeGuard)));
+
+        if ((simdEqualIntMask(yTileLow, yTileHigh) & simdLatitudeMask(latitude)) == SIMD_ALL_LANES)
+        {
+            simdStoreInt(&xTiles[i], simdTruncInt(x));
+            simdStoreInt(&yTiles[i], yTileLow);
+        }
+        else
+            for (int j=0; j<SIMD_WIDTH; j++)
+                projectTile(traceRecs[i+j].latitude, traceRecs[i+j].longitude, numTiles, xTiles[i+j], yTiles[i+j]);
+    }
+#endif
+    for ( ; i < count; i++)
+        projectTile(traceRecs[i].latitude, traceRecs[i].longitude, numTiles, xTiles[i], yTiles[i]);
+}
 
 /**
 *
@@ -1031,40 +6637,205 @@ double rad2deg(double rad)
     return (rad * 180 / 3.1415926);
 }
 
-/**************************************************************
- *                        selectionSort                       *
- * This function performs an descending-order selection sort   *
- * on array. The parameter size holds the number of elements  *
- * in the array.                                              *
- **************************************************************/
-void selectionSort(mach2kStruct mach2kRec[], int size)
-{
-    double num1, num2;
-    int minIndex,swapsMade2 = 0; //all of these will hold a temporary value
-
-    mach2kStruct minValue[1]; // this creates an object to hold temporary object values
-
-	for (int startScan = 0; startScan < (size - 1); startScan++)
-	{
-		minIndex = startScan;           //the first index starts at 0
-		minValue[0] = mach2kRec[startScan];    //the minimum value is the very first number now
-		for(int index = startScan + 1; index < size; index++)
-		{
-		    //these next four lines change the string variables in to usable integer types for comparison
-		    stringstream ss(mach2kRec[index].dura);
-                ss >> num1;
-            stringstream ss1(minValue[0].dura);
-                ss1 >>num2;
-			if (num1 > num2) //if the number we have is greater than number 2
-			{
-				minValue[0] = mach2kRec[index]; //we have the current value of index which is now the new temporary value
-				minIndex = index;                // temp index is now the number we are on
-				swapsMade2++;                    //increment for the swap we just made
-			}
-
-      } // moved start all the way to the end of the array
-		mach2kRec[minIndex] = mach2kRec[startScan]; // we now change the list to reflect the lowest value we found
-		mach2kRec[startScan] = minValue[0];    //the smallest value is added and the loop is repeated
-
-	} // end last scan through array
+/**
+*
+* Indexes of all machRecCnt locations by duration in descending order. Equal durations
+* keep the order the locations were first recorded in.
+*
+**/
+vector<int> sortLocations(const mach2kStruct mach2kRec[], int machRecCnt)
+{
+    stageTimer timer(STAGE_SORT);
+    vector<int> order(machRecCnt);
+    for (int i = 0; i < machRecCnt; i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [mach2kRec](int a, int b)
+    {
+        return (mach2kRec[a].dura > mach2kRec[b].dura) || ((mach2kRec[a].dura == mach2kRec[b].dura) && (a < b));
+    });
+    return order;
+}
+
+/**
+*
+* Indexes of the topCnt (> 0) longest locations in topIdx, longest first and in the same
+* order as sortLocations(), without sorting the rest. Returns how many were found
+* (fewer than topCnt if there are fewer locations).
+*
+**/
+int topLocations(const mach2kStruct mach2kRec[], int machRecCnt, int topCnt, int topIdx[])
+{
+    int foundCnt = 0;
+    for (int i = 0; i < machRecCnt; i++)
+    {
+        double dura = mach2kRec[i].dura;
+        if ((foundCnt == topCnt) && !(dura > mach2kRec[topIdx[topCnt-1]].dura))
+            continue;           // not longer than the shortest kept, an earlier location wins a tie
+
+        /** Insert i in order, dropping the shortest if the list is full **/
+        int j = (foundCnt < topCnt) ? foundCnt++ : topCnt - 1;
+        while ((j > 0) && (dura > mach2kRec[topIdx[j-1]].dura))
+        {
+            topIdx[j] = topIdx[j-1];
+            j--;
+        }
+        topIdx[j] = i;
+    }
+    return foundCnt;
+}
+
+/**
+*
+* Add a qualifying stay, given as the dayNum start/end of each span of time added to duraTime,
+* to a location's hour of week histogram. Spans are split at hour (and midnight) boundaries,
+* so a stay from 08:40 to 10:15 adds 20, 60 and 15 minutes to hours 8, 9 and 10. The record's
+* hour and dow are then set to the busiest hour of the week.
+*
+**/
+void addDwellHist(dwellHistStruct &hist, mach2kStruct &machRec, const pair<double, double> staySpans[], size_t spanCnt)
+{
+    for (size_t i = 0; i < spanCnt; i++)
+    {
+        const pair<double, double> &span = staySpans[i];
+        double start = span.first;
+        while (start < span.second)
+        {
+            double hourNum = floor(start*24.0);                 // hours since 12/30/1899, a Saturday
+            double end = min(span.second, (hourNum + 1.0)/24.0);
+            int64_t dayNum = (int64_t)hourNum / 24;
+            hist.secs[(dayNum + 6) % 7][(int64_t)hourNum % 24] += (uint32_t)lround((end - start)*24.0*60.0*60.0);
+            if (end <= start)                                   // hour boundary not representable, stop
+                break;
+            start = end;
+        }
+    }
+
+    int peakDow = 0, peakHour = 0;
+    for (int d = 0; d < 7; d++)
+        for (int h = 0; h < 24; h++)
+            if (hist.secs[d][h] > hist.secs[peakDow][peakHour])
+            {
+                peakDow = d;
+                peakHour = h;
+            }
+    if (hist.secs[peakDow][peakHour] > 0)
+    {
+        machRec.hour = peakHour;
+        machRec.dow = peakDow;
+    }
+}
+
+/**
+*
+* Time of week regularity of a subject's qualifying stays, between 0 and 1: one minus the
+* entropy of each location's hour of week histogram over the entropy of all 168 hours equally
+* likely, averaged over the locations weighted by their histogram time. 1 is every stay at a
+* location in the same hour of the week, 0 is stays spread evenly over the week. Locations
+* read from a MACH2K.txt have no histogram and are left out.
+*
+**/
+double weekRegularity(const dwellHistStruct dwellHist[], int machRecCnt)
+{
+    double weightedSum = 0.0, totSecs = 0.0;
+    for (int i = 0; i < machRecCnt; i++)
+    {
+        const uint32_t *secs = &dwellHist[i].secs[0][0];
+        double locSecs = 0.0;
+        for (int j = 0; j < 7*24; j++)
+            locSecs += secs[j];
+        if (locSecs <= 0.0)
+            continue;
+        double entropy = 0.0;
+        for (int j = 0; j < 7*24; j++)
+            if (secs[j] > 0)
+                entropy -= (secs[j]/locSecs)*log(secs[j]/locSecs);
+        weightedSum += locSecs*(1.0 - entropy/log(7.0*24.0));
+        totSecs += locSecs;
+    }
+    return (totSecs > 0.0) ? weightedSum/totSecs : 0.0;
+}
+
+/**
+*
+* Parse argv[4]: one secs. in place (3600) or a list (900,1800,3600). Duplicates are dropped,
+* the order is kept.
+*
+**/
+bool parseDurations(const string &durationArg, vector<int> &durations)
+{
+    stringstream durationList(durationArg);
+    string item;
+    while (getline(durationList, item, ','))
+    {
+        char *end;
+        long secs = strtol(item.c_str(), &end, 10);
+        if ((end == item.c_str()) || (*end != '\0') || (secs < 0) || (secs > 7*24*60*60))
+            return false;
+        if (find(durations.begin(), durations.end(), (int)secs) == durations.end())
+            durations.push_back((int)secs);
+    }
+    return !durations.empty();
+}
+
+/**
+*
+* Parse argv[3]: one zoom level (16), a list (12,14,16) or a range (12-20), each 1-21.
+* Duplicates are dropped, the order is kept.
+*
+**/
+bool parseZoomLevels(const string &zoomArg, vector<int> &zoomLevels)
+{
+    stringstream zoomList(zoomArg);
+    string item;
+    while (getline(zoomList, item, ','))
+    {
+        int first, last;
+        size_t dash = item.find('-');
+        char *end;
+        first = strtol(item.c_str(), &end, 10);
+        if (dash == string::npos)
+        {
+            last = first;
+            if ((end == item.c_str()) || (*end != '\0'))
+                return false;
+        }
+        else
+        {
+            const char *lastStr = item.c_str() + dash + 1;
+            if ((end != item.c_str() + dash) || (dash == 0))
+                return false;
+            last = strtol(lastStr, &end, 10);
+            if ((end == lastStr) || (*end != '\0'))
+                return false;
+        }
+        if ((first < 1) || (last > 21) || (first > last))
+            return false;
+        for (int zoom = first; zoom <= last; zoom++)
+            if (find(zoomLevels.begin(), zoomLevels.end(), zoom) == zoomLevels.end())
+                zoomLevels.push_back(zoom);
+    }
+    return !zoomLevels.empty();
+}
+
+/**
+*
+* MACH2K file name suffix for params[paramIdx]: none for a single zoom level and secs. in place,
+* the same names as before, _zZZ when a run has more than one zoom level and _sSSSS when it has
+* more than one secs. in place (_zZZ_sSSSS with both)
+*
+**/
+string paramFileSuffix(const vector<runParamStruct> &params, size_t paramIdx)
+{
+    bool zooms = false, durations = false;
+    for (const runParamStruct &param : params)
+    {
+        zooms = zooms || (param.zoomLevelStr != params[0].zoomLevelStr);
+        durations = durations || (param.durationStr != params[0].durationStr);
+    }
+    string suffix;
+    if (zooms)
+        suffix += "_z" + params[paramIdx].zoomLevelStr;
+    if (durations)
+        suffix += "_s" + params[paramIdx].durationStr;
+    return suffix;
 }
@@ -1 +1,2 @@
-for %%X in (*.plt) do (mach2ktile.exe %%X %1 16 3600 >> mach2ktile.log)
\ No newline at end of file
+for %%X in (*.plt) do (mach2ktile.exe %%X %1 16 3600 >> mach2ktile.log)
+mach2ktile.exe -export-csv %1_MACH2K.bin >> mach2ktile.log
\ No newline at end of file